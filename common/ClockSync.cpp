@@ -0,0 +1,50 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#include "ClockSync.hpp"
+
+constexpr size_t ClockSync::k_window;
+
+bool ClockSync::AddExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    int64_t roundTripTime = (t4 - t1) - (t3 - t2);
+    if (t4 < t1 || t3 < t2 || roundTripTime < 0) {
+        return false;
+    }
+
+    m_exchanges[m_next] = Exchange{((t2 - t1) + (t3 - t4)) / 2, roundTripTime};
+    m_next = (m_next + 1) % k_window;
+    if (m_count < k_window) {
+        m_count++;
+    }
+
+    /* Search the whole window again, since the exchange just overwritten may
+     * have been the best one
+     */
+    m_best = m_exchanges[0];
+    for (size_t i = 1; i < m_count; i++) {
+        if (m_exchanges[i].roundTripTime < m_best.roundTripTime) {
+            m_best = m_exchanges[i];
+        }
+    }
+
+    return true;
+}
+
+bool ClockSync::HasEstimate() const { return m_count > 0; }
+
+int64_t ClockSync::Offset() const { return m_best.offset; }
+
+int64_t ClockSync::RoundTripTime() const { return m_best.roundTripTime; }
+
+int64_t ClockSync::ToLocal(int64_t remoteTime) const {
+    return remoteTime - m_best.offset;
+}
+
+int64_t ClockSync::ToRemote(int64_t localTime) const {
+    return localTime + m_best.offset;
+}
+
+void ClockSync::Reset() {
+    m_count = 0;
+    m_next = 0;
+    m_best = Exchange{0, 0};
+}
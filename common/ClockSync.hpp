@@ -0,0 +1,76 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+/**
+ * Estimates the offset between a local clock and a remote one from NTP-style
+ * ping/pong exchanges, such as LiveGrapher's k_hostTimeSyncPacket or Insight's
+ * "tsync" command.
+ *
+ * Each exchange has four timestamps in microseconds: t1 when the request was
+ * sent and t4 when the reply arrived, on the local clock, and t2 when the
+ * request arrived and t3 when the reply was sent, on the remote clock. An
+ * exchange measures
+ *
+ *     offset = ((t2 - t1) + (t3 - t4)) / 2
+ *     round trip time = (t4 - t1) - (t3 - t2)
+ *
+ * and its offset is wrong by at most half the round trip time. Queueing delay
+ * only ever adds to the round trip time, so of the last k_window exchanges,
+ * the one with the shortest round trip time is used.
+ *
+ * Example:
+ *     ClockSync sync;
+ *     sync.AddExchange(t1, t2, t3, t4);
+ *
+ *     if (sync.HasEstimate()) {
+ *         int64_t local = sync.ToLocal(remoteMilliseconds * 1000);
+ *     }
+ */
+class ClockSync {
+public:
+    // Number of recent exchanges the estimate is chosen from
+    static constexpr size_t k_window = 8;
+
+    /* Adds an exchange. Returns false and ignores it if the timestamps are
+     * inconsistent, such as a reply that arrived before its request was sent.
+     */
+    bool AddExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+    // Returns true once an exchange has been added
+    bool HasEstimate() const;
+
+    // Returns the remote clock minus the local clock in microseconds
+    int64_t Offset() const;
+
+    /* Returns the round trip time of the exchange the offset came from. Half
+     * of it bounds the offset's error.
+     */
+    int64_t RoundTripTime() const;
+
+    // Converts between remote and local timestamps in microseconds
+    int64_t ToLocal(int64_t remoteTime) const;
+    int64_t ToRemote(int64_t localTime) const;
+
+    // Forgets every exchange, such as after either clock was stepped
+    void Reset();
+
+private:
+    struct Exchange {
+        int64_t offset;
+        int64_t roundTripTime;
+    };
+
+    // The last k_window exchanges, written in a ring
+    std::array<Exchange, k_window> m_exchanges;
+    size_t m_count = 0;
+    size_t m_next = 0;
+
+    // The exchange with the shortest round trip time in the window
+    Exchange m_best{0, 0};
+};
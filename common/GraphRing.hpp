@@ -0,0 +1,96 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+/* Layout of the POSIX shared memory ring that GraphHost::StartSharedMemory()
+ * publishes points into. Processes on the robot read it with GraphRingReader
+ * instead of connecting over TCP.
+ *
+ * The object starts with a GraphRingHeader, followed by maxDatasets
+ * GraphRingDataset entries, then capacity GraphRingSlot entries. The writer
+ * puts sample i in slot i % capacity, overwriting the sample from the previous
+ * lap. Each slot is a seqlock: its sequence is odd while it's being written, so
+ * a reader that sees the same even sequence before and after copying a slot
+ * knows the copy is whole.
+ *
+ * Fields are in the robot's native byte order, since only local processes can
+ * map the ring.
+ */
+
+// "LGR1" in the first four bytes, read as a native integer
+constexpr uint32_t k_graphRingMagic = 0x3152474C;
+constexpr uint32_t k_graphRingVersion = 1;
+
+// Longest dataset name, including the terminating NUL
+constexpr size_t k_graphRingNameLength = 64;
+
+struct GraphRingHeader {
+    // Stored last, once the rest of the header is filled in
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+
+    // Number of sample slots, a power of two
+    uint32_t capacity;
+
+    // Number of entries in the dataset table
+    uint32_t maxDatasets;
+
+    /* Number of dataset table entries filled in. Entries are never changed
+     * once counted.
+     */
+    std::atomic<uint32_t> datasetCount;
+
+    /* Set when the writer stops. A new ring may then be created under the
+     * same name.
+     */
+    std::atomic<uint32_t> closed;
+
+    // Number of samples written so far
+    std::atomic<uint64_t> writeIndex;
+};
+
+struct GraphRingDataset {
+    // NUL-terminated name, truncated to fit
+    char name[k_graphRingNameLength];
+};
+
+struct GraphRingSlot {
+    /* For sample i, with lap = i / capacity, this is 2 * lap + 1 while the
+     * slot is being written and 2 * lap + 2 once it's done. It starts at zero.
+     */
+    std::atomic<uint32_t> sequence;
+
+    std::atomic<uint32_t> dataset;
+
+    // Milliseconds since the epoch
+    std::atomic<uint64_t> time;
+
+    // Bits of the float value
+    std::atomic<uint32_t> value;
+
+    uint32_t padding;
+};
+
+// Another process can only share atomics that don't fall back to a lock
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "GraphRing needs lock-free 32 and 64-bit atomics");
+
+// Returns the size of a ring with the given dimensions
+inline size_t GraphRingSize(size_t capacity, size_t maxDatasets) {
+    return sizeof(GraphRingHeader) + maxDatasets * sizeof(GraphRingDataset) +
+           capacity * sizeof(GraphRingSlot);
+}
+
+inline GraphRingDataset* GraphRingDatasets(GraphRingHeader* header) {
+    return reinterpret_cast<GraphRingDataset*>(header + 1);
+}
+
+inline GraphRingSlot* GraphRingSlots(GraphRingHeader* header) {
+    return reinterpret_cast<GraphRingSlot*>(GraphRingDatasets(header) +
+                                            header->maxDatasets);
+}
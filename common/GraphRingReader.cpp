@@ -0,0 +1,130 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#include "GraphRingReader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+GraphRingReader::~GraphRingReader() { Close(); }
+
+bool GraphRingReader::Open(const std::string& name) {
+    Close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+
+    // The writer may not have sized the object yet
+    struct stat info;
+    if (fstat(fd, &info) == -1 ||
+        static_cast<size_t>(info.st_size) < sizeof(GraphRingHeader)) {
+        close(fd);
+        return false;
+    }
+
+    m_size = info.st_size;
+    m_map = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m_map == MAP_FAILED) {
+        m_map = nullptr;
+        return false;
+    }
+
+    m_header = static_cast<GraphRingHeader*>(m_map);
+    if (m_header->magic.load(std::memory_order_acquire) != k_graphRingMagic ||
+        m_header->version != k_graphRingVersion ||
+        GraphRingSize(m_header->capacity, m_header->maxDatasets) > m_size) {
+        Close();
+        return false;
+    }
+
+    m_datasets = GraphRingDatasets(m_header);
+    m_slots = GraphRingSlots(m_header);
+    m_capacity = m_header->capacity;
+
+    // Start at the oldest point that hasn't been overwritten
+    uint64_t writeIndex =
+        m_header->writeIndex.load(std::memory_order_acquire);
+    m_readIndex = writeIndex > m_capacity ? writeIndex - m_capacity : 0;
+    m_lostSamples = 0;
+
+    return true;
+}
+
+void GraphRingReader::Close() {
+    if (m_map != nullptr) {
+        munmap(m_map, m_size);
+    }
+
+    m_map = nullptr;
+    m_header = nullptr;
+    m_datasets = nullptr;
+    m_slots = nullptr;
+}
+
+bool GraphRingReader::IsOpen() const { return m_header != nullptr; }
+
+bool GraphRingReader::IsWriterClosed() const {
+    return IsOpen() && m_header->closed.load(std::memory_order_acquire);
+}
+
+bool GraphRingReader::Read(Sample& sample) {
+    if (!IsOpen()) {
+        return false;
+    }
+
+    while (true) {
+        uint64_t writeIndex =
+            m_header->writeIndex.load(std::memory_order_acquire);
+        if (m_readIndex >= writeIndex) {
+            return false;
+        }
+
+        // Skip what the writer has already lapped
+        if (writeIndex - m_readIndex > m_capacity) {
+            m_lostSamples += writeIndex - m_capacity - m_readIndex;
+            m_readIndex = writeIndex - m_capacity;
+        }
+
+        const GraphRingSlot& slot = m_slots[m_readIndex & (m_capacity - 1)];
+        uint32_t expected = 2 * (m_readIndex / m_capacity) + 2;
+
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        uint16_t dataset = slot.dataset.load(std::memory_order_relaxed);
+        uint64_t time = slot.time.load(std::memory_order_relaxed);
+        uint32_t bits = slot.value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = slot.sequence.load(std::memory_order_relaxed);
+
+        if (before == expected && after == expected) {
+            sample.dataset = dataset;
+            sample.time = time;
+            std::memcpy(&sample.value, &bits, sizeof(bits));
+            m_readIndex++;
+            return true;
+        }
+
+        /* The writer overwrote the slot while it was being read. Loop so the
+         * lapped points are skipped.
+         */
+        m_lostSamples++;
+        m_readIndex++;
+    }
+}
+
+std::string GraphRingReader::DatasetName(uint16_t dataset) const {
+    if (!IsOpen() ||
+        dataset >= m_header->datasetCount.load(std::memory_order_acquire)) {
+        return "";
+    }
+
+    const char* name = m_datasets[dataset].name;
+    return std::string(name, strnlen(name, k_graphRingNameLength));
+}
+
+uint64_t GraphRingReader::LostSamples() const { return m_lostSamples; }
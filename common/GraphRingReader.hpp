@@ -0,0 +1,83 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "GraphRing.hpp"
+
+/**
+ * Reads the points GraphHost publishes into a shared memory ring. Reading
+ * makes no system calls and never blocks the robot, so it suits loggers and
+ * watchdogs running next to the robot program.
+ *
+ * The reader keeps its own position in the ring. Points overwritten before
+ * they were read are skipped and counted by LostSamples().
+ *
+ * Example:
+ *     GraphRingReader reader;
+ *     reader.Open("/livegrapher");
+ *
+ *     GraphRingReader::Sample sample;
+ *     while (reader.Read(sample)) {
+ *         std::cout << reader.DatasetName(sample.dataset) << ": "
+ *                   << sample.value << '\n';
+ *     }
+ */
+class GraphRingReader {
+public:
+    struct Sample {
+        uint16_t dataset;
+        uint64_t time;
+        float value;
+    };
+
+    GraphRingReader() = default;
+    ~GraphRingReader();
+    GraphRingReader(const GraphRingReader&) = delete;
+    GraphRingReader& operator=(const GraphRingReader&) = delete;
+
+    /* Maps the ring 'name' and starts at its oldest point. Returns false if it
+     * doesn't exist or isn't ready yet.
+     */
+    bool Open(const std::string& name);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    /* Returns true if the writer has stopped. Points already in the ring can
+     * still be read, but Open() must be called again to follow a new writer.
+     */
+    bool IsWriterClosed() const;
+
+    /* Copies the next point into 'sample'. Returns false if there are no new
+     * points.
+     */
+    bool Read(Sample& sample);
+
+    /* Returns the name of a dataset, or an empty string if the writer hasn't
+     * named it yet
+     */
+    std::string DatasetName(uint16_t dataset) const;
+
+    // Returns the number of points that were overwritten before being read
+    uint64_t LostSamples() const;
+
+private:
+    void* m_map = nullptr;
+    size_t m_size = 0;
+
+    GraphRingHeader* m_header = nullptr;
+    GraphRingDataset* m_datasets = nullptr;
+    GraphRingSlot* m_slots = nullptr;
+    uint32_t m_capacity = 0;
+
+    // Index of the next sample to read
+    uint64_t m_readIndex = 0;
+
+    uint64_t m_lostSamples = 0;
+};
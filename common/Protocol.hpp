@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <string>
@@ -33,3 +34,110 @@ struct ClientListPacket {
 
 constexpr uint8_t k_clientDataPacket = 0b00 << 6;
 constexpr uint8_t k_clientListPacket = 0b01 << 6;
+
+/* Version 2 packets use the otherwise unused 0b11 packet type. The low six bits
+ * select the packet instead of holding a dataset ID. A connection speaks
+ * version 1 until the client sends a hello packet.
+ */
+constexpr uint8_t k_protocolVersion = 2;
+
+// Version 2 dataset IDs are below this
+constexpr size_t k_maxDatasets = 1024;
+
+struct [[gnu::packed]] HostHelloPacket {
+    uint8_t ID;
+    uint8_t version;
+};
+
+struct [[gnu::packed]] HostSubscribePacket {
+    uint8_t ID;
+    uint16_t dataset;
+};
+
+// Subscribes to a dataset at no more than 'rate' buckets per second
+struct [[gnu::packed]] HostSubscribeRatePacket {
+    uint8_t ID;
+    uint16_t dataset;
+    uint16_t rate;
+};
+
+/* Asks for the host's clock. 'clientTime' is the client's clock in
+ * microseconds when it sent the packet, and is echoed back. See ClockSync.hpp.
+ */
+struct [[gnu::packed]] HostTimeSyncPacket {
+    uint8_t ID;
+    uint64_t clientTime;
+};
+
+constexpr uint8_t k_hostHelloPacket = 0b11 << 6 | 0;
+constexpr uint8_t k_hostConnectPacketV2 = 0b11 << 6 | 1;
+constexpr uint8_t k_hostDisconnectPacketV2 = 0b11 << 6 | 2;
+constexpr uint8_t k_hostConnectRatePacket = 0b11 << 6 | 3;
+constexpr uint8_t k_hostStatsPacket = 0b11 << 6 | 4;
+constexpr uint8_t k_hostTimeSyncPacket = 0b11 << 6 | 5;
+
+struct [[gnu::packed]] ClientHelloPacket {
+    uint8_t ID;
+    uint8_t version;
+};
+
+// Followed by 'count' dataset entries
+struct [[gnu::packed]] ClientListHeaderV2 {
+    uint8_t ID;
+    uint16_t count;
+};
+
+// Followed by 'length' bytes of the dataset name
+struct [[gnu::packed]] ClientListEntryV2 {
+    uint16_t dataset;
+    uint8_t encoding;
+    float scale;
+    uint8_t length;
+};
+
+/* Followed by 'length' bytes of samples. Each sample is a 16-bit dataset ID, a
+ * varint holding milliseconds since baseTime, and the value in the dataset's
+ * encoding.
+ */
+struct [[gnu::packed]] ClientFrameHeader {
+    uint8_t ID;
+    uint16_t length;
+    uint64_t baseTime;
+};
+
+/* Reply to k_hostStatsPacket. Times are in microseconds, and the per-client
+ * fields describe the connection that asked.
+ */
+struct [[gnu::packed]] ClientStatsPacket {
+    uint8_t ID;
+    uint16_t clients;
+    uint32_t queuedBytes;
+    uint32_t bytesPerSecond;
+    uint64_t sentBytes;
+    uint64_t droppedPackets;
+    uint64_t droppedSamples;
+    uint32_t maxLoopTime;
+    uint32_t maxPublishTime;
+};
+
+/* Reply to k_hostTimeSyncPacket. 'receiveTime' and 'transmitTime' are the
+ * host's system clock in microseconds since the epoch when the request was
+ * read and when the reply was queued.
+ */
+struct [[gnu::packed]] ClientTimeSyncPacket {
+    uint8_t ID;
+    uint64_t clientTime;
+    uint64_t receiveTime;
+    uint64_t transmitTime;
+};
+
+constexpr uint8_t k_clientHelloPacket = 0b11 << 6 | 0;
+constexpr uint8_t k_clientListPacketV2 = 0b11 << 6 | 1;
+constexpr uint8_t k_clientFramePacket = 0b11 << 6 | 2;
+constexpr uint8_t k_clientStatsPacket = 0b11 << 6 | 3;
+constexpr uint8_t k_clientTimeSyncPacket = 0b11 << 6 | 4;
+
+// Sample value encodings for version 2 frames
+constexpr uint8_t k_encodingFloat32 = 0;
+constexpr uint8_t k_encodingFloat16 = 1;
+constexpr uint8_t k_encodingQuantized16 = 2;
@@ -2,66 +2,192 @@
 
 #include "DSDisplay.hpp"
 
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include "NetReactor.hpp"
+
+constexpr DSDisplay::ElementID DSDisplay::k_invalidElement;
+constexpr size_t DSDisplay::k_guiChunkSize;
+constexpr std::chrono::milliseconds DSDisplay::k_refreshPeriod;
 
 DSDisplay& DSDisplay::GetInstance(uint16_t dsPort) {
     static DSDisplay dsDisplay(dsPort);
     return dsDisplay;
 }
 
+DSDisplay::~DSDisplay() {
+    NetReactor::GetInstance().Remove(m_socket.getHandle());
+}
+
 void DSDisplay::Clear() { m_packet.clear(); }
 
-void DSDisplay::SendToDS() {
-    if (m_dsIP != sf::IpAddress::None) {
-        m_socket.send(m_packet, m_dsIP, m_dsPort);
+void DSDisplay::AddSubscriber(sf::IpAddress ip, uint16_t port,
+                              bool binaryDisplay) {
+    auto& subscriber = Subscribe(ip, port);
+    subscriber.permanent = true;
+    subscriber.binaryDisplay = binaryDisplay;
+}
+
+void DSDisplay::RemoveSubscriber(sf::IpAddress ip, uint16_t port) {
+    auto subscriber = FindSubscriber(ip, port);
+    if (subscriber != m_subscribers.end()) {
+        m_subscribers.erase(subscriber);
     }
+}
 
-    // Used for testing purposes
-    m_socket.send(m_packet, sf::IpAddress(10, 35, 12, 42), m_dsPort);
+void DSDisplay::SetSubscriberTimeout(std::chrono::milliseconds timeout) {
+    m_subscriberTimeout = timeout;
 }
 
-const std::string DSDisplay::ReceiveFromDS() {
-    if (m_socket.receive(m_recvBuffer, 256, m_recvAmount, m_recvIP,
-                         m_recvPort) == sf::Socket::Done) {
-        if (std::strncmp(m_recvBuffer, "connect\r\n", 9) == 0) {
-            m_dsIP = m_recvIP;
-            m_dsPort = m_recvPort;
+void DSDisplay::SendToDS() {
+    ExpireSubscribers();
 
-            // Send GUI element file to DS
-            Clear();
+    if (m_packet.getDataSize() > 0) {
+        Send(m_packet);
+    }
 
-            m_packet << static_cast<std::string>("guiCreate\r\n");
+    /* Updates are sent over UDP only when a value changes, so a lost packet
+     * would leave the Driver Station showing an old value until the next
+     * change. Resending every value periodically recovers from that.
+     */
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastRefresh >= k_refreshPeriod) {
+        MarkAllDirty();
+        m_lastRefresh = now;
+    }
+
+    if (m_dirtyElements.empty()) {
+        return;
+    }
+
+    // Only build the packets someone will receive
+    bool binary = false;
+    bool text = false;
+    for (const auto& subscriber : m_subscribers) {
+        if (subscriber.binaryDisplay) {
+            binary = true;
+        } else {
+            text = true;
+        }
+    }
 
-            // Open the file
-            std::ifstream guiFile("/home/lvuser/GUISettings.txt",
-                                  std::ifstream::binary);
+    if (binary) {
+        PackBinaryElements();
+        Send(m_elementPacket, Recipients::Binary);
+    }
+    if (text) {
+        PackTextElements();
+        Send(m_elementTextPacket, Recipients::Text);
+    }
 
-            if (guiFile.is_open()) {
-                // Get its length
-                guiFile.seekg(0, guiFile.end);
-                unsigned int fileSize = guiFile.tellg();
-                guiFile.seekg(0, guiFile.beg);
+    for (auto ID : m_dirtyElements) {
+        m_elements[ID].dirty = false;
+    }
+    m_dirtyElements.clear();
+}
 
-                // Send the length
-                m_packet << static_cast<uint32_t>(fileSize);
+void DSDisplay::PackBinaryElements() {
+    m_elementPacket.clear();
+    m_elementPacket << std::string("display2\r\n");
+    m_elementPacket << static_cast<uint16_t>(m_dirtyElements.size());
+
+    for (auto ID : m_dirtyElements) {
+        const auto& element = m_elements[ID];
+
+        m_elementPacket << ID;
+        m_elementPacket << element.type;
+
+        // Floating point values are sent big-endian like the integers
+        switch (element.type) {
+            case 'c':
+                m_elementPacket << static_cast<int8_t>(element.bits);
+                break;
+            case 'i':
+                m_elementPacket << static_cast<int32_t>(element.bits);
+                break;
+            case 'u':
+            case 'f':
+                m_elementPacket << static_cast<uint32_t>(element.bits);
+                break;
+            case 'd':
+                // sf::Packet doesn't byte swap 64-bit integers
+                m_elementPacket << static_cast<uint32_t>(element.bits >> 32);
+                m_elementPacket << static_cast<uint32_t>(element.bits);
+                break;
+            case 's':
+                m_elementPacket << element.text;
+                break;
+        }
+    }
+}
 
-                // Allocate a buffer for the file
-                auto tempBuf = new char[fileSize];
+void DSDisplay::PackTextElements() {
+    m_elementTextPacket.clear();
+    m_elementTextPacket << std::string("display\r\n");
 
-                // Send the data
-                guiFile.read(tempBuf, fileSize);
-                m_packet.append(tempBuf, fileSize);
+    for (auto ID : m_dirtyElements) {
+        const auto& element = m_elements[ID];
 
-                delete[] tempBuf;
-                guiFile.close();
+        // floats and doubles are sent as strings like the name-based AddData()
+        if (element.type == 'f' || element.type == 'd') {
+            m_elementTextPacket << static_cast<int8_t>('s');
+        } else {
+            m_elementTextPacket << element.type;
+        }
+        m_elementTextPacket << element.name;
+
+        switch (element.type) {
+            case 'c':
+                m_elementTextPacket << static_cast<int8_t>(element.bits);
+                break;
+            case 'i':
+                m_elementTextPacket << static_cast<int32_t>(element.bits);
+                break;
+            case 'u':
+                m_elementTextPacket << static_cast<uint32_t>(element.bits);
+                break;
+            case 'f': {
+                float value;
+                uint32_t bits = element.bits;
+                std::memcpy(&value, &bits, sizeof(value));
+                m_elementTextPacket << std::to_string(value);
+                break;
+            }
+            case 'd': {
+                double value;
+                std::memcpy(&value, &element.bits, sizeof(value));
+                m_elementTextPacket << std::to_string(value);
+                break;
             }
+            case 's':
+                m_elementTextPacket << element.text;
+                break;
+        }
+    }
+}
+
+const std::string DSDisplay::ReceiveFromDS() {
+    std::string command = "NONE";
 
-            SendToDS();
+    Request request;
+    while (m_requests.Pop(request)) {
+        if (request.command == Request::Connect) {
+            Subscribe(request.ip, request.port).binaryDisplay =
+                request.binaryDisplay;
 
-            // Send a list of available autonomous modes
+            /* The NetReactor thread already sent GUISettings.txt. Send a list
+             * of available autonomous modes.
+             */
             Clear();
 
             m_packet << static_cast<std::string>("autonList\r\n");
@@ -70,7 +196,7 @@ const std::string DSDisplay::ReceiveFromDS() {
                 m_packet << m_autonModes.Name(i);
             }
 
-            SendToDS();
+            Send(m_packet);
 
             // Make sure driver knows which autonomous mode is selected
             Clear();
@@ -78,12 +204,17 @@ const std::string DSDisplay::ReceiveFromDS() {
             m_packet << static_cast<std::string>("autonConfirmed\r\n");
             m_packet << m_autonModes.Name(m_curAutonMode);
 
-            SendToDS();
+            Send(m_packet);
+            Clear();
 
-            return "connect\r\n";
-        } else if (std::strncmp(m_recvBuffer, "autonSelect\r\n", 13) == 0) {
-            // Next byte after command is selection choice
-            m_curAutonMode = m_recvBuffer[13];
+            // Give the new Driver Station every element's current value
+            MarkAllDirty();
+
+            command = "connect\r\n";
+        } else if (request.command == Request::AutonSelect) {
+            RenewSubscriber(request.ip, request.port);
+
+            m_curAutonMode = request.autonMode;
 
             Clear();
 
@@ -105,16 +236,81 @@ const std::string DSDisplay::ReceiveFromDS() {
                     << "DSDisplay: autonSelect: failed to open autonMode.txt\n";
             }
 
-            SendToDS();
+            Send(m_packet);
+            Clear();
+
+            command = "autonSelect\r\n";
+        } else if (request.command == Request::KeepAlive) {
+            RenewSubscriber(request.ip, request.port, true);
+        }
+    }
+
+    return command;
+}
+
+void DSDisplay::ReceivePackets() {
+    /* The socket is non-blocking, so read until it's empty. A batch that
+     * isn't full already emptied it.
+     */
+    size_t count;
+    do {
+        count = m_recvBatch.Receive(m_socket.getHandle());
+
+        // Requests are handled in the order they arrived
+        for (size_t i = 0; i < count; i++) {
+            ParseRequest(m_recvBatch.Data(i), m_recvBatch.Size(i),
+                         m_recvBatch.Address(i), m_recvBatch.Port(i));
+        }
+    } while (count == m_recvBatch.Capacity());
+}
 
-            return "autonSelect\r\n";
+void DSDisplay::ParseRequest(const char* buffer, size_t size, sf::IpAddress ip,
+                             uint16_t port) {
+    Request request;
+    request.ip = ip;
+    request.port = port;
+
+    if (size >= 9 && std::strncmp(buffer, "connect\r\n", 9) == 0) {
+        request.command = Request::Connect;
+
+        /* Newer Driver Stations follow with the version they support. 2 adds
+         * "display2\r\n" and 3 adds "guiChunk\r\n".
+         */
+        uint8_t version = size >= 10 ? buffer[9] : 1;
+        request.binaryDisplay = version >= 2;
+
+        // Sending the file here keeps the reconnect off the robot loop
+        if (version >= 3) {
+            for (auto& chunk : m_guiChunks) {
+                m_socket.send(chunk, ip, port);
+            }
+        } else if (m_guiCreate.getDataSize() > 0) {
+            m_socket.send(m_guiCreate, ip, port);
         }
+    } else if (size >= 13 && std::strncmp(buffer, "guiResend\r\n", 11) == 0) {
+        // Next two bytes after command are the missing chunk's index
+        uint16_t index = (static_cast<uint8_t>(buffer[11]) << 8) |
+                         static_cast<uint8_t>(buffer[12]);
+        if (index < m_guiChunks.size()) {
+            m_socket.send(m_guiChunks[index], ip, port);
+        }
+        return;
+    } else if (size >= 14 &&
+               std::strncmp(buffer, "autonSelect\r\n", 13) == 0) {
+        // Next byte after command is selection choice
+        request.command = Request::AutonSelect;
+        request.autonMode = buffer[13];
+    } else if (size >= 11 && std::strncmp(buffer, "keepalive\r\n", 11) == 0) {
+        request.command = Request::KeepAlive;
+    } else {
+        return;
     }
 
-    return "NONE";
+    // If the robot loop isn't keeping up, the Driver Station will retry
+    m_requests.Push(request);
 }
 
-DSDisplay::DSDisplay(uint16_t portNumber) : m_dsPort(portNumber) {
+DSDisplay::DSDisplay(uint16_t portNumber) {
     m_socket.bind(portNumber);
     m_socket.setBlocking(false);
 
@@ -148,6 +344,201 @@ DSDisplay::DSDisplay(uint16_t portNumber) : m_dsPort(portNumber) {
     } else {
         m_curAutonMode = 0;
     }
+
+    LoadGUISettings();
+
+    NetReactor::GetInstance().Add(m_socket.getHandle(), EPOLLIN,
+                                  [this](uint32_t) { ReceivePackets(); });
+}
+
+void DSDisplay::LoadGUISettings() {
+    std::ifstream guiFile("/home/lvuser/GUISettings.txt",
+                          std::ifstream::binary);
+    std::string contents;
+    if (guiFile.is_open()) {
+        contents.assign(std::istreambuf_iterator<char>(guiFile),
+                        std::istreambuf_iterator<char>());
+    } else {
+        std::cout << "DSDisplay: failed to open GUISettings.txt\n";
+    }
+
+    // Older Driver Stations get the whole file in one packet
+    m_guiCreate << std::string("guiCreate\r\n");
+    if (guiFile.is_open()) {
+        m_guiCreate << static_cast<uint32_t>(contents.size());
+        m_guiCreate.append(contents.data(), contents.size());
+    }
+    if (m_guiCreate.getDataSize() > sf::UdpSocket::MaxDatagramSize) {
+        std::cout << "DSDisplay: GUISettings.txt is too large for "
+                     "guiCreate\n";
+        m_guiCreate.clear();
+    }
+
+    /* Split the file into datagrams small enough to avoid IP fragmentation.
+     * An empty file still gets one chunk so the Driver Station hears about it.
+     */
+    size_t chunkCount = (contents.size() + k_guiChunkSize - 1) / k_guiChunkSize;
+    if (chunkCount == 0) {
+        chunkCount = 1;
+    }
+    if (chunkCount > UINT16_MAX) {
+        std::cout << "DSDisplay: GUISettings.txt is too large\n";
+        chunkCount = UINT16_MAX;
+        contents.resize(chunkCount * k_guiChunkSize);
+    }
+
+    m_guiChunks.resize(chunkCount);
+    for (size_t i = 0; i < chunkCount; i++) {
+        size_t offset = i * k_guiChunkSize;
+        size_t size = std::min(k_guiChunkSize, contents.size() - offset);
+
+        auto& chunk = m_guiChunks[i];
+        chunk << std::string("guiChunk\r\n");
+        chunk << static_cast<uint16_t>(i);
+        chunk << static_cast<uint16_t>(chunkCount);
+        chunk << static_cast<uint32_t>(contents.size());
+        chunk << static_cast<uint32_t>(offset);
+        chunk.append(contents.data() + offset, size);
+    }
+
+    /* Each line is an element type followed by a comma-separated list of the
+     * names the element reads from, then its layout and text
+     */
+    std::istringstream fileStream(contents);
+    std::string line;
+    while (std::getline(fileStream, line)) {
+        std::istringstream lineStream(line);
+        std::string type;
+        std::string names;
+        if (!(lineStream >> type >> names)) {
+            continue;
+        }
+
+        std::istringstream nameStream(names);
+        std::string name;
+        while (std::getline(nameStream, name, ',')) {
+            if (name.empty() || m_elementIDs.count(name) > 0) {
+                continue;
+            }
+            if (m_elements.size() == k_invalidElement) {
+                std::cout << "DSDisplay: GUISettings.txt has too many "
+                             "elements\n";
+                return;
+            }
+
+            m_elementIDs.emplace(name, m_elements.size());
+            m_elements.emplace_back();
+            m_elements.back().name = name;
+        }
+    }
+
+    m_dirtyElements.reserve(m_elements.size());
+}
+
+void DSDisplay::MarkDirty(ElementID ID) {
+    auto& element = m_elements[ID];
+    if (!element.dirty) {
+        element.dirty = true;
+        m_dirtyElements.emplace_back(ID);
+    }
+}
+
+DSDisplay::Subscriber& DSDisplay::Subscribe(sf::IpAddress ip,
+                                            uint16_t port) {
+    auto subscriber = FindSubscriber(ip, port);
+    if (subscriber == m_subscribers.end()) {
+        Subscriber newSubscriber;
+        std::memset(&newSubscriber.address, 0, sizeof(sockaddr_in));
+        newSubscriber.address.sin_family = AF_INET;
+        newSubscriber.address.sin_addr.s_addr = htonl(ip.toInteger());
+        newSubscriber.address.sin_port = htons(port);
+
+        m_subscribers.emplace_back(newSubscriber);
+        subscriber = m_subscribers.end() - 1;
+    }
+
+    subscriber->lastSeen = std::chrono::steady_clock::now();
+    return *subscriber;
+}
+
+void DSDisplay::RenewSubscriber(sf::IpAddress ip, uint16_t port,
+                                bool keepAlive) {
+    auto subscriber = FindSubscriber(ip, port);
+    if (subscriber != m_subscribers.end()) {
+        subscriber->lastSeen = std::chrono::steady_clock::now();
+        subscriber->keepsAlive |= keepAlive;
+    }
+}
+
+std::vector<DSDisplay::Subscriber>::iterator DSDisplay::FindSubscriber(
+    sf::IpAddress ip, uint16_t port) {
+    return std::find_if(
+        m_subscribers.begin(), m_subscribers.end(), [&](const auto& sub) {
+            return sub.address.sin_addr.s_addr == htonl(ip.toInteger()) &&
+                   sub.address.sin_port == htons(port);
+        });
+}
+
+void DSDisplay::MarkAllDirty() {
+    for (ElementID ID = 0; ID < m_elements.size(); ID++) {
+        if (m_elements[ID].type != 0) {
+            MarkDirty(ID);
+        }
+    }
+}
+
+void DSDisplay::ExpireSubscribers() {
+    /* Drop Driver Stations that stopped sending keepalives. Ones that never
+     * sent any don't know they have to.
+     */
+    auto now = std::chrono::steady_clock::now();
+    m_subscribers.erase(
+        std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                       [&](const auto& sub) {
+                           return !sub.permanent && sub.keepsAlive &&
+                                  now - sub.lastSeen > m_subscriberTimeout;
+                       }),
+        m_subscribers.end());
+}
+
+void DSDisplay::Send(sf::Packet& packet, Recipients recipients) {
+    // Every message shares the packet's buffer
+    iovec buffer;
+    buffer.iov_base = const_cast<void*>(packet.getData());
+    buffer.iov_len = packet.getDataSize();
+
+    m_messages.clear();
+    for (auto& subscriber : m_subscribers) {
+        if ((recipients == Recipients::Binary && !subscriber.binaryDisplay) ||
+            (recipients == Recipients::Text && subscriber.binaryDisplay)) {
+            continue;
+        }
+
+        mmsghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_hdr.msg_name = &subscriber.address;
+        message.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        message.msg_hdr.msg_iov = &buffer;
+        message.msg_hdr.msg_iovlen = 1;
+        m_messages.emplace_back(message);
+    }
+
+    /* sendmmsg() stops at the first message that fails, so skip past it. Like
+     * a lossy network, a failed send (e.g., a full send buffer on the
+     * non-blocking socket or an unreachable subscriber) drops the packet.
+     */
+    size_t sent = 0;
+    while (sent < m_messages.size()) {
+        int count = sendmmsg(m_socket.getHandle(), &m_messages[sent],
+                             m_messages.size() - sent, 0);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            count = 1;
+        }
+        sent += count;
+    }
 }
 
 void DSDisplay::DeleteAllMethods() { m_autonModes.DeleteAllMethods(); }
@@ -158,7 +549,22 @@ void DSDisplay::ExecAutonomous() {
 
 char DSDisplay::GetAutonID() const { return m_curAutonMode; }
 
-void DSDisplay::AddData(std::string ID, StatusLight data) {
+DSDisplay::ElementID DSDisplay::GetElementID(const std::string& name) const {
+    auto ID = m_elementIDs.find(name);
+    if (ID == m_elementIDs.end()) {
+        return k_invalidElement;
+    }
+
+    return ID->second;
+}
+
+void DSDisplay::AddData(const std::string& ID, StatusLight data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -169,7 +575,13 @@ void DSDisplay::AddData(std::string ID, StatusLight data) {
     m_packet << static_cast<int8_t>(data);
 }
 
-void DSDisplay::AddData(std::string ID, bool data) {
+void DSDisplay::AddData(const std::string& ID, bool data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -185,7 +597,13 @@ void DSDisplay::AddData(std::string ID, bool data) {
     }
 }
 
-void DSDisplay::AddData(std::string ID, int8_t data) {
+void DSDisplay::AddData(const std::string& ID, int8_t data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -196,7 +614,13 @@ void DSDisplay::AddData(std::string ID, int8_t data) {
     m_packet << data;
 }
 
-void DSDisplay::AddData(std::string ID, int32_t data) {
+void DSDisplay::AddData(const std::string& ID, int32_t data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -207,7 +631,13 @@ void DSDisplay::AddData(std::string ID, int32_t data) {
     m_packet << data;
 }
 
-void DSDisplay::AddData(std::string ID, uint32_t data) {
+void DSDisplay::AddData(const std::string& ID, uint32_t data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -218,7 +648,13 @@ void DSDisplay::AddData(std::string ID, uint32_t data) {
     m_packet << data;
 }
 
-void DSDisplay::AddData(std::string ID, std::string data) {
+void DSDisplay::AddData(const std::string& ID, std::string data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -229,7 +665,13 @@ void DSDisplay::AddData(std::string ID, std::string data) {
     m_packet << data;
 }
 
-void DSDisplay::AddData(std::string ID, float data) {
+void DSDisplay::AddData(const std::string& ID, float data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -240,7 +682,13 @@ void DSDisplay::AddData(std::string ID, float data) {
     m_packet << std::to_string(data);
 }
 
-void DSDisplay::AddData(std::string ID, double data) {
+void DSDisplay::AddData(const std::string& ID, double data) {
+    auto elementID = GetElementID(ID);
+    if (elementID != k_invalidElement) {
+        AddData(elementID, data);
+        return;
+    }
+
     // If packet is empty, add "display\r\n" header to packet
     if (m_packet.getData() == nullptr) {
         m_packet << std::string("display\r\n");
@@ -250,3 +698,55 @@ void DSDisplay::AddData(std::string ID, double data) {
     m_packet << ID;
     m_packet << std::to_string(data);
 }
+
+void DSDisplay::AddData(ElementID ID, StatusLight data) {
+    SetElement(ID, 'c', static_cast<int8_t>(data));
+}
+
+void DSDisplay::AddData(ElementID ID, bool data) {
+    if (data == true) {
+        SetElement(ID, 'c', static_cast<int8_t>(DSDisplay::active));
+    } else {
+        SetElement(ID, 'c', static_cast<int8_t>(DSDisplay::inactive));
+    }
+}
+
+void DSDisplay::AddData(ElementID ID, int8_t data) {
+    SetElement(ID, 'c', data);
+}
+
+void DSDisplay::AddData(ElementID ID, int32_t data) {
+    SetElement(ID, 'i', data);
+}
+
+void DSDisplay::AddData(ElementID ID, uint32_t data) {
+    SetElement(ID, 'u', data);
+}
+
+void DSDisplay::AddData(ElementID ID, const std::string& data) {
+    if (ID >= m_elements.size()) {
+        return;
+    }
+
+    auto& element = m_elements[ID];
+    if (element.type != 's' || element.text != data) {
+        element.type = 's';
+        element.text = data;
+        MarkDirty(ID);
+    }
+}
+
+void DSDisplay::AddData(ElementID ID, float data) {
+    /* Values are compared by their bits so a NaN that keeps being set isn't
+     * resent every time
+     */
+    uint32_t bits;
+    std::memcpy(&bits, &data, sizeof(bits));
+    SetElement(ID, 'f', bits);
+}
+
+void DSDisplay::AddData(ElementID ID, double data) {
+    uint64_t bits;
+    std::memcpy(&bits, &data, sizeof(bits));
+    SetElement(ID, 'd', bits);
+}
@@ -2,14 +2,21 @@
 
 #pragma once
 
+#include <netinet/in.h>
 #include <stdint.h>
+#include <sys/socket.h>
 
+#include <chrono>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "AutonContainer.hpp"
+#include "DatagramBatch.hpp"
 #include "SFML/Network/IpAddress.hpp"
 #include "SFML/Network/Packet.hpp"
 #include "SFML/Network/UdpSocket.hpp"
+#include "SpscQueue.hpp"
 
 /* This class allows you to pack data into an SFML packet and send it to an
  * application on the DriverStation that displays it in a GUI.
@@ -40,18 +47,63 @@
  * Note: It doesn't matter in which order the data in the received packet is
  *       extracted in the application on the Driver Station.
  *
- * The packets are always sent to 10.35.12.42 for testing purposes
+ * Each element name in GUISettings.txt is given an integer ID when the class is
+ * created. Look an ID up once with GetElementID() and pass it to AddData()
+ * instead of the name. SendToDS() then sends only the elements whose values
+ * changed since the last call. A Driver Station that sends a byte of 2 after
+ * "connect\r\n" gets them as typed binary values in a "display2\r\n" packet.
+ * Other Driver Stations get them as strings in a "display\r\n" packet like
+ * before. The IDs are the order in which the names first appear in the file,
+ * so the Driver Station derives the same IDs from the file it receives on
+ * connect. AddData() calls with a name in the file use the same path; other
+ * names are still packed as strings into the "display\r\n" packet.
+ *
+ * GUISettings.txt is read once when the class is created, so restart the robot
+ * program after changing it. It's sent to a Driver Station that connects in
+ * numbered chunks, and the Driver Station can ask for lost chunks again.
+ *
+ * Requests from the Driver Station are received and parsed on the NetReactor
+ * thread. ReceiveFromDS() only handles the requests that have arrived since it
+ * was last called, so it makes no system calls when there are none.
+ *
+ * Packets are sent to every subscriber with one sendmmsg(2) call. A Driver
+ * Station subscribes by connecting. Once it has sent "keepalive\r\n", it must
+ * keep sending that or another request at least once per subscriber timeout
+ * to stay subscribed. Driver Stations that never send "keepalive\r\n" and
+ * addresses added with AddSubscriber() never expire.
  */
 
 class DSDisplay {
 public:
     enum StatusLight : int8_t { active, standby, inactive };
 
+    // Index of a GUI element in GUISettings.txt
+    using ElementID = uint16_t;
+
+    // Returned by GetElementID() for names not in GUISettings.txt
+    static constexpr ElementID k_invalidElement = 0xffff;
+
     static DSDisplay& GetInstance(uint16_t dsPort);
 
+    ~DSDisplay();
+
     // Empties internal packet of data
     void Clear();
 
+    /* Sends packets to the given address until RemoveSubscriber() is called.
+     * If 'binaryDisplay' is true, element values are sent to it in
+     * "display2\r\n" packets. The subscriber functions must be called from
+     * the thread that calls SendToDS().
+     */
+    void AddSubscriber(sf::IpAddress ip, uint16_t port,
+                       bool binaryDisplay = false);
+    void RemoveSubscriber(sf::IpAddress ip, uint16_t port);
+
+    /* Sets how long a connected Driver Station that sends "keepalive\r\n" may
+     * go without a request
+     */
+    void SetSubscriberTimeout(std::chrono::milliseconds timeout);
+
     // Sends data currently in class's internal packet to Driver Station
     void SendToDS();
 
@@ -70,6 +122,9 @@ public:
     // Returns position of currently selected autonomous in function array
     char GetAutonID() const;
 
+    // Returns the ID of the GUI element with the given name
+    ElementID GetElementID(const std::string& name) const;
+
     /* Add UI element data to packet
      *
      * The types allowed for 'data' are char, int, unsigned int, std::wstring,
@@ -81,16 +136,81 @@ public:
      * compile time. floats and doubles are converted to strings because VxWorks
      * messes up floats over the network.
      */
-    void AddData(std::string ID, StatusLight data);
-    void AddData(std::string ID, bool data);
-    void AddData(std::string ID, int8_t data);
-    void AddData(std::string ID, int32_t data);
-    void AddData(std::string ID, uint32_t data);
-    void AddData(std::string ID, std::string data);
-    void AddData(std::string ID, float data);
-    void AddData(std::string ID, double data);
+    void AddData(const std::string& ID, StatusLight data);
+    void AddData(const std::string& ID, bool data);
+    void AddData(const std::string& ID, int8_t data);
+    void AddData(const std::string& ID, int32_t data);
+    void AddData(const std::string& ID, uint32_t data);
+    void AddData(const std::string& ID, std::string data);
+    void AddData(const std::string& ID, float data);
+    void AddData(const std::string& ID, double data);
+
+    /* Set the value of a GUI element by ID
+     *
+     * The value is only sent if it differs from the last one sent. floats and
+     * doubles are sent in binary rather than converted to strings. IDs of
+     * k_invalidElement are ignored.
+     */
+    void AddData(ElementID ID, StatusLight data);
+    void AddData(ElementID ID, bool data);
+    void AddData(ElementID ID, int8_t data);
+    void AddData(ElementID ID, int32_t data);
+    void AddData(ElementID ID, uint32_t data);
+    void AddData(ElementID ID, const std::string& data);
+    void AddData(ElementID ID, float data);
+    void AddData(ElementID ID, double data);
 
 private:
+    // A Driver Station request parsed by the NetReactor thread
+    struct Request {
+        enum Command : uint8_t { Connect, AutonSelect, KeepAlive };
+
+        Command command;
+        sf::IpAddress ip;
+        uint16_t port;
+
+        // Selected autonomous mode for AutonSelect
+        char autonMode;
+
+        // True if a Connect request asked for "display2\r\n" packets
+        bool binaryDisplay = false;
+    };
+
+    // The last value given to a GUI element
+    struct Element {
+        // Name in GUISettings.txt, used for "display\r\n" packets
+        std::string name;
+
+        // Type identifier of the value, or 0 if it hasn't been set
+        int8_t type = 0;
+
+        // Numeric value, or the bits of a floating point value
+        uint64_t bits = 0;
+
+        // Value of a string
+        std::string text;
+
+        // True if the value has changed since the last SendToDS()
+        bool dirty = false;
+    };
+
+    // An address to which packets are sent
+    struct Subscriber {
+        sockaddr_in address;
+
+        // When the Driver Station last sent a request
+        std::chrono::steady_clock::time_point lastSeen;
+
+        // True if the subscriber was added with AddSubscriber()
+        bool permanent = false;
+
+        // True if element values are sent in "display2\r\n" packets
+        bool binaryDisplay = false;
+
+        // Set once the Driver Station sent "keepalive\r\n" so it can expire
+        bool keepsAlive = false;
+    };
+
     explicit DSDisplay(uint16_t portNumber);
 
     DSDisplay(const DSDisplay&) = delete;
@@ -98,24 +218,104 @@ private:
 
     sf::Packet m_packet;
 
+    /* Packets of changed element values built by SendToDS() for subscribers
+     * that do and don't use "display2\r\n"
+     */
+    sf::Packet m_elementPacket;
+    sf::Packet m_elementTextPacket;
+
+    // Bytes of GUISettings.txt sent in each packet
+    static constexpr size_t k_guiChunkSize = 1024;
+
+    /* GUISettings.txt as one "guiCreate\r\n" packet, or empty if it doesn't
+     * fit in a datagram, and split into "guiChunk\r\n" packets. Both are built
+     * before the NetReactor thread starts and only used by it afterward.
+     */
+    sf::Packet m_guiCreate;
+    std::vector<sf::Packet> m_guiChunks;
+
+    // Maps element names in GUISettings.txt to their IDs
+    std::map<std::string, ElementID> m_elementIDs;
+
+    // Indexed by element ID
+    std::vector<Element> m_elements;
+
+    // IDs of elements whose values changed since the last SendToDS()
+    std::vector<ElementID> m_dirtyElements;
+
+    // How often SendToDS() resends every element's value
+    static constexpr std::chrono::milliseconds k_refreshPeriod{1000};
+    std::chrono::steady_clock::time_point m_lastRefresh;
+
     sf::UdpSocket m_socket;  // socket for sending data to Driver Station
-    sf::IpAddress m_dsIP{sf::IpAddress::None};  // IP address of Driver Station
-    uint16_t m_dsPort;                          // port to which to send data
 
-    // Stores IP address temporarily during receive
-    sf::IpAddress m_recvIP{0, 0, 0, 0};
+    // Destinations of every packet sent from the robot loop
+    std::vector<Subscriber> m_subscribers;
+    std::chrono::milliseconds m_subscriberTimeout{5000};
 
-    // Stores port temporarily during receive
-    uint16_t m_recvPort = 0;
+    // Reused by Send() so it doesn't allocate
+    std::vector<mmsghdr> m_messages;
 
-    // Buffer for Driver Station requests
-    char m_recvBuffer[256];
+    // The following receive state is only used by the NetReactor thread
 
-    // Holds number of bytes received from Driver Station
-    size_t m_recvAmount = 0;
+    // Buffers for Driver Station requests
+    DatagramBatch<16, 256> m_recvBatch;
+
+    // Requests waiting for ReceiveFromDS()
+    SpscQueue<Request, 16> m_requests;
 
     AutonContainer m_autonModes;
     char m_curAutonMode;
+
+    // Reads and parses datagrams on the NetReactor thread
+    void ReceivePackets();
+    void ParseRequest(const char* buffer, size_t size, sf::IpAddress ip,
+                      uint16_t port);
+
+    /* Splits GUISettings.txt into packets for the Driver Station and assigns
+     * IDs to its element names
+     */
+    void LoadGUISettings();
+
+    /* Stores an integer element value and marks it dirty if it changed.
+     * Floating point values are passed as their bits.
+     */
+    template <class T>
+    void SetElement(ElementID ID, int8_t type, T data);
+
+    // Marks an element for sending by the next SendToDS()
+    void MarkDirty(ElementID ID);
+
+    // Marks every element that has a value for sending
+    void MarkAllDirty();
+
+    /* Adds a subscriber or, if it's already subscribed, renews it. Returns
+     * the subscriber.
+     */
+    Subscriber& Subscribe(sf::IpAddress ip, uint16_t port);
+
+    /* Renews a subscriber if it's subscribed. 'keepAlive' marks it as sending
+     * keepalives.
+     */
+    void RenewSubscriber(sf::IpAddress ip, uint16_t port,
+                         bool keepAlive = false);
+
+    // Returns the subscriber with the given address, or end() if none
+    std::vector<Subscriber>::iterator FindSubscriber(sf::IpAddress ip,
+                                                     uint16_t port);
+
+    // Drops subscribers that stopped sending keepalives
+    void ExpireSubscribers();
+
+    // Selects which subscribers Send() sends a packet to
+    enum class Recipients { All, Binary, Text };
+
+    // Sends a packet to the selected subscribers
+    void Send(sf::Packet& packet, Recipients recipients = Recipients::All);
+
+    // Packs m_dirtyElements into m_elementPacket or m_elementTextPacket
+    void PackBinaryElements();
+    void PackTextElements();
 };
 
 #include "DSDisplay.inl"
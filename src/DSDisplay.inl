@@ -3,9 +3,29 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
 
 template <class T>
 void DSDisplay::AddAutoMethod(const std::string& methodName,
                               void (T::*function)(), T* object) {
     m_autonModes.AddMethod(methodName, std::bind(function, object));
 }
+
+template <class T>
+void DSDisplay::SetElement(ElementID ID, int8_t type, T data) {
+    static_assert(std::is_integral<T>::value, "Element value isn't an integer");
+
+    if (ID >= m_elements.size()) {
+        return;
+    }
+
+    // Converting back to T in SendToDS() undoes any sign extension
+    auto bits = static_cast<uint64_t>(data);
+
+    auto& element = m_elements[ID];
+    if (element.type != type || element.bits != bits) {
+        element.type = type;
+        element.bits = bits;
+        MarkDirty(ID);
+    }
+}
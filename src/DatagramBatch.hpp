@@ -0,0 +1,46 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "SFML/Network/IpAddress.hpp"
+
+/**
+ * Fixed buffers for reading up to N UDP datagrams with one recvmmsg(2) call
+ *
+ * Datagrams longer than BufferSize bytes are truncated. The data returned by
+ * Data() is only valid until the next call to Receive().
+ */
+template <size_t N, size_t BufferSize>
+class DatagramBatch {
+public:
+    DatagramBatch();
+
+    DatagramBatch(const DatagramBatch&) = delete;
+    DatagramBatch& operator=(const DatagramBatch&) = delete;
+
+    /* Reads the datagrams waiting on the non-blocking socket 'fd', up to N.
+     * Returns how many were read, which is 0 if none were waiting.
+     */
+    size_t Receive(int fd);
+
+    // Accessors for the datagrams read by the last Receive() call
+    const char* Data(size_t i) const;
+    size_t Size(size_t i) const;
+    sf::IpAddress Address(size_t i) const;
+    uint16_t Port(size_t i) const;
+
+    static constexpr size_t Capacity() { return N; }
+
+private:
+    mmsghdr m_messages[N];
+    iovec m_buffers[N];
+    sockaddr_in m_addresses[N];
+    char m_data[N][BufferSize];
+};
+
+#include "DatagramBatch.inl"
@@ -0,0 +1,63 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <arpa/inet.h>
+
+#include <cerrno>
+#include <cstring>
+
+template <size_t N, size_t BufferSize>
+DatagramBatch<N, BufferSize>::DatagramBatch() {
+    std::memset(m_messages, 0, sizeof(m_messages));
+
+    for (size_t i = 0; i < N; i++) {
+        m_buffers[i].iov_base = m_data[i];
+        m_buffers[i].iov_len = BufferSize;
+
+        auto& header = m_messages[i].msg_hdr;
+        header.msg_name = &m_addresses[i];
+        header.msg_iov = &m_buffers[i];
+        header.msg_iovlen = 1;
+    }
+}
+
+template <size_t N, size_t BufferSize>
+size_t DatagramBatch<N, BufferSize>::Receive(int fd) {
+    // recvmmsg() overwrites the address lengths with what it received
+    for (size_t i = 0; i < N; i++) {
+        m_messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+
+    int count;
+    do {
+        count = recvmmsg(fd, m_messages, N, 0, nullptr);
+    } while (count == -1 && errno == EINTR);
+
+    // Either the socket is empty (EAGAIN) or there's nothing to read anyway
+    if (count == -1) {
+        return 0;
+    }
+
+    return count;
+}
+
+template <size_t N, size_t BufferSize>
+const char* DatagramBatch<N, BufferSize>::Data(size_t i) const {
+    return m_data[i];
+}
+
+template <size_t N, size_t BufferSize>
+size_t DatagramBatch<N, BufferSize>::Size(size_t i) const {
+    return m_messages[i].msg_len;
+}
+
+template <size_t N, size_t BufferSize>
+sf::IpAddress DatagramBatch<N, BufferSize>::Address(size_t i) const {
+    return sf::IpAddress(ntohl(m_addresses[i].sin_addr.s_addr));
+}
+
+template <size_t N, size_t BufferSize>
+uint16_t DatagramBatch<N, BufferSize>::Port(size_t i) const {
+    return ntohs(m_addresses[i].sin_port);
+}
@@ -2,9 +2,36 @@
 
 #include "Insight.hpp"
 
+#include <sys/epoll.h>
+
+#include <chrono>
 #include <cstring>
 
-Insight::~Insight() { m_socket.unbind(); }
+#include "NetReactor.hpp"
+
+constexpr size_t Insight::k_numTargets;
+
+// Returns the system clock in microseconds since the epoch
+static uint64_t SystemMicroseconds() {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::system_clock;
+
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Writes 'value' to 'buf' in network byte order
+static void PutUint64(char* buf, uint64_t value) {
+    for (size_t i = 0; i < 8; i++) {
+        buf[i] = value >> (8 * (7 - i));
+    }
+}
+
+Insight::~Insight() {
+    NetReactor::GetInstance().Remove(m_socket.getHandle());
+    m_socket.unbind();
+}
 
 Insight& Insight::GetInstance(uint16_t dsPort) {
     static Insight instance(dsPort);
@@ -12,39 +39,107 @@ Insight& Insight::GetInstance(uint16_t dsPort) {
 }
 
 std::string Insight::ReceiveFromDS() {
-    if (m_socket.receive(m_recvBuffer, 256, m_recvAmount, m_recvIP,
-                         m_recvPort) == sf::Socket::Done) {
-        if (std::strncmp(m_recvBuffer, "ctrl\r\n", 6) == 0) {
-            m_targets.clear();
-            for (unsigned int i = 0; i < k_numTargets; i++) {
-                if (m_recvBuffer[8 + i * 2] != 0 ||
-                    m_recvBuffer[9 + i * 2] != 0) {
-                    m_targets.emplace_back(m_recvBuffer[8 + i * 2],
-                                           m_recvBuffer[9 + i * 2]);
-                }
-            }
-            m_hasNewData = true;
-            return "ctrl\r\n";
-        }
-    } else {
-        m_hasNewData = false;
+    if (!m_targets.Update()) {
+        return "NONE";
     }
-    return "NONE";
+
+    // Target sets published in between were overwritten before this one
+    uint64_t sequence = m_targets.ReadBuffer().sequence;
+    m_coalescedPackets += sequence - m_lastSequence - 1;
+    m_lastSequence = sequence;
+
+    m_hasNewData = true;
+    return "ctrl\r\n";
+}
+
+bool Insight::HasNewData() {
+    bool hasNewData = m_hasNewData;
+    m_hasNewData = false;
+    return hasNewData;
 }
 
-bool Insight::HasNewData() const { return m_hasNewData; }
+const Insight::TargetSet& Insight::GetTargets() const {
+    return m_targets.ReadBuffer();
+}
 
-const std::pair<char, char>& Insight::GetTarget(size_t i) {
-    return m_targets[i];
+const std::pair<char, char>& Insight::GetTarget(size_t i) const {
+    return m_targets.ReadBuffer().targets[i];
 }
 
-size_t Insight::GetNumTargets() const { return m_targets.size(); }
+size_t Insight::GetNumTargets() const { return m_targets.ReadBuffer().count; }
+
+uint64_t Insight::GetCoalescedPackets() const { return m_coalescedPackets; }
 
 Insight::Insight(uint16_t portNumber) {
     m_socket.bind(portNumber);
     m_socket.setBlocking(false);
-    m_recvIP = sf::IpAddress(0, 0, 0, 0);
-    m_recvPort = 0;
-    m_recvAmount = 0;
-    m_hasNewData = false;
+
+    NetReactor::GetInstance().Add(m_socket.getHandle(), EPOLLIN,
+                                  [this](uint32_t) { ReceivePackets(); });
+}
+
+void Insight::ReceivePackets() {
+    // Copied out of the batch since its buffers are reused by each Receive()
+    char newest[8 + k_numTargets * 2];
+    uint64_t newestTime = 0;
+    bool received = false;
+
+    /* The socket is non-blocking, so read until it's empty. A batch that
+     * isn't full already emptied it.
+     */
+    size_t count;
+    do {
+        count = m_recvBatch.Receive(m_socket.getHandle());
+        uint64_t receiveTime = SystemMicroseconds();
+
+        /* Time sync requests are answered in order. Of the target packets,
+         * only the newest is parsed.
+         */
+        for (size_t i = 0; i < count; i++) {
+            const char* buffer = m_recvBatch.Data(i);
+            size_t size = m_recvBatch.Size(i);
+
+            if (size >= 15 && std::strncmp(buffer, "tsync\r\n", 7) == 0) {
+                SendTimeSync(buffer, m_recvBatch.Address(i),
+                             m_recvBatch.Port(i), receiveTime);
+            } else if (size >= sizeof(newest) &&
+                       std::strncmp(buffer, "ctrl\r\n", 6) == 0) {
+                std::memcpy(newest, buffer, sizeof(newest));
+                newestTime = receiveTime;
+                received = true;
+                m_sequence++;
+            }
+        }
+    } while (count == m_recvBatch.Capacity());
+
+    if (received) {
+        Publish(newest, newestTime);
+    }
+}
+
+void Insight::Publish(const char* packet, uint64_t receiveTime) {
+    auto& targetSet = m_targets.WriteBuffer();
+
+    targetSet.count = 0;
+    for (size_t i = 0; i < k_numTargets; i++) {
+        if (packet[8 + i * 2] != 0 || packet[9 + i * 2] != 0) {
+            targetSet.targets[targetSet.count++] = {packet[8 + i * 2],
+                                                    packet[9 + i * 2]};
+        }
+    }
+    targetSet.sequence = m_sequence;
+    targetSet.receiveTime = receiveTime;
+
+    m_targets.Publish();
+}
+
+void Insight::SendTimeSync(const char* request, sf::IpAddress ip,
+                           uint16_t port, uint64_t receiveTime) {
+    // The command and the client's time are echoed back as they arrived
+    char reply[15 + 2 * 8];
+    std::memcpy(reply, request, 15);
+    PutUint64(&reply[15], receiveTime);
+    PutUint64(&reply[23], SystemMicroseconds());
+
+    m_socket.send(reply, sizeof(reply), ip, port);
 }
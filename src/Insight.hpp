@@ -2,47 +2,106 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <array>
 #include <cstddef>
 #include <string>
 #include <utility>
-#include <vector>
 
+#include "DatagramBatch.hpp"
 #include "SFML/Network/IpAddress.hpp"
 #include "SFML/Network/UdpSocket.hpp"
+#include "TripleBuffer.hpp"
 
 /**
  * Receives Insight's processed target data
+ *
+ * Packets are received in batches and parsed on the NetReactor thread. Only the
+ * newest "ctrl" packet of the ones waiting is parsed into a fixed-size target
+ * set, which is published through a triple buffer. ReceiveFromDS() picks up
+ * the newest complete set without locking or allocating. The older packets
+ * skipped along the way are counted by GetCoalescedPackets().
+ *
+ * To line up vision timestamps with the robot's, Insight may send "tsync\r\n"
+ * followed by its clock in microseconds as a big-endian uint64_t. The robot
+ * answers right away from the NetReactor thread with the same 15 bytes, then
+ * its system clock in microseconds since the epoch when the request was
+ * received and when the reply was sent, both as big-endian uint64_ts. See
+ * common/ClockSync.hpp for turning those into a clock offset.
  */
 class Insight {
 public:
+    static constexpr size_t k_numTargets = 1;
+
+    // Targets parsed from one "ctrl" packet
+    struct TargetSet {
+        std::array<std::pair<char, char>, k_numTargets> targets;
+        size_t count = 0;
+
+        // Number of "ctrl" packets received up to and including this one
+        uint64_t sequence = 0;
+
+        /* System clock in microseconds since the epoch when the packet was
+         * received. It's the clock used to answer "tsync" requests.
+         */
+        uint64_t receiveTime = 0;
+    };
+
     Insight(const Insight&) = delete;
     Insight& operator=(const Insight&) = delete;
     virtual ~Insight();
 
     static Insight& GetInstance(uint16_t dsPort);
 
-    // Receives control commands from Driver Station and processes them
+    // Picks up the newest target set. Returns "ctrl\r\n" if there was one.
     std::string ReceiveFromDS();
 
-    // Returns true if new target data has been received
-    bool HasNewData() const;
+    /* Returns true if ReceiveFromDS() has picked up new target data since the
+     * last call to this function
+     */
+    bool HasNewData();
 
-    // Provides access to target data
-    const std::pair<char, char>& GetTarget(size_t i);
+    /* Provides access to the target set picked up by ReceiveFromDS(). The
+     * reference is valid until the next call to ReceiveFromDS().
+     */
+    const TargetSet& GetTargets() const;
+    const std::pair<char, char>& GetTarget(size_t i) const;
     size_t GetNumTargets() const;
 
+    /* Returns how many target packets were replaced by newer ones before
+     * ReceiveFromDS() could pick them up
+     */
+    uint64_t GetCoalescedPackets() const;
+
 private:
     explicit Insight(uint16_t portNumber);
 
     sf::UdpSocket m_socket;
-    sf::IpAddress m_recvIP;  // stores IP address temporarily during receive
-    uint16_t m_recvPort;     // stores port temporarily during receive
 
-    char m_recvBuffer[256];  // buffer for Insight packets
-    size_t m_recvAmount;  // holds number of bytes received from Driver Station
+    // The following receive state is only used by the NetReactor thread
+
+    // Buffers for Insight packets
+    DatagramBatch<16, 256> m_recvBatch;
+
+    // Number of "ctrl" packets received
+    uint64_t m_sequence = 0;
+
+    // Target sets written by the NetReactor thread and read by ReceiveFromDS()
+    TripleBuffer<TargetSet> m_targets;
+
+    // The following state is only used by the thread calling ReceiveFromDS()
+    uint64_t m_lastSequence = 0;
+    uint64_t m_coalescedPackets = 0;
+    bool m_hasNewData = false;
+
+    // Reads and parses datagrams on the NetReactor thread
+    void ReceivePackets();
 
-    std::vector<std::pair<char, char>> m_targets;
-    bool m_hasNewData;
+    // Parses a "ctrl" packet and publishes its targets
+    void Publish(const char* packet, uint64_t receiveTime);
 
-    static constexpr int k_numTargets = 1;
+    // Answers the 15-byte "tsync" request in 'request'
+    void SendTimeSync(const char* request, sf::IpAddress ip, uint16_t port,
+                      uint64_t receiveTime);
 };
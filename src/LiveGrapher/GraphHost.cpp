@@ -2,24 +2,87 @@
 
 #include "GraphHost.hpp"
 
-#include <algorithm>
-#include <cstring>
-
-#ifdef __VXWORKS__
-#include <hostLib.h>
-#include <pipeDrv.h>
-#include <selectLib.h>
-#include <sockLib.h>
-
-#include <cstdio>
-#define be64toh(x) x
-#else
+#include <arpa/inet.h>
 #include <endian.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <signal.h>
-#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+#include "../NetReactor.hpp"
+
+constexpr size_t GraphHost::k_maxDatasets;
+constexpr size_t GraphHost::k_telemetryClients;
+constexpr GraphHost::DatasetHandle GraphHost::k_invalidDataset;
+constexpr size_t GraphHost::k_maxDatasetsV1;
+constexpr size_t GraphHost::k_maxFrameLength;
+
+// Returns the system clock in microseconds since the epoch
+static uint64_t SystemMicroseconds() {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::system_clock;
+
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+/* Converts a float to an IEEE 754 half-precision float, rounding to nearest
+ * even. Values too large for a half become infinity.
+ */
+static uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Infinity and NaN
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    }
+
+    if (exponent >= 0x1F) {
+        return sign | 0x7C00;
+    }
+
+    if (exponent <= 0) {
+        // Too small even for a subnormal half
+        if (exponent < -10) {
+            return sign;
+        }
+
+        // Subnormal half, so shift in the implicit leading one
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent
+    uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return half;
+}
 
 GraphHost::GraphHost(int port) {
     using std::chrono::duration_cast;
@@ -33,97 +96,359 @@ GraphHost::GraphHost(int port) {
     // Store the port to listen on
     m_port = port;
 
-    // Create a pipe for IPC with the thread
-    int pipefd[2];
-#ifdef __VXWORKS__
-    pipeDevCreate("/pipe/graphhost", 10, 100);
-    pipefd[0] = open("/pipe/graphhost", O_RDONLY, 0644);
-    pipefd[1] = open("/pipe/graphhost", O_WRONLY, 0644);
-
-    if (pipefd[0] == -1 || pipefd[1] == -1) {
+    /* An eventfd wakes the thread. Writes to it never block, and any number of
+     * wakeups collapse into one read.
+     */
+    m_ipcfd_r = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_ipcfd_r == -1) {
         return;
     }
-#else
-    if (pipe(pipefd) == -1) {
+
+    m_ipcfd_w = m_ipcfd_r;
+
+    // Listen on a socket
+    m_listenfd = socket_listen(m_port, 0);
+    if (m_listenfd == -1) {
         return;
     }
-#endif
 
-    m_ipcfd_r = pipefd[0];
-    m_ipcfd_w = pipefd[1];
+    // The listener and eventfd are level-triggered
+    auto& reactor = NetReactor::GetInstance();
+    reactor.Add(m_listenfd, EPOLLIN, [this](uint32_t) { OnAccept(); });
+    reactor.Add(m_ipcfd_r, EPOLLIN, [this](uint32_t) { OnWake(m_ipcfd_r); });
 
-    // Launch the thread
-    m_thread = std::thread([this] { socket_threadmain(); });
+    // Set the running flag after we've finished initializing everything
+    m_running = true;
 }
 
 GraphHost::~GraphHost() {
-    // Tell the other thread to stop
-    write(m_ipcfd_w, "x", 1);
+    // The sampler thread wakes the socket thread, so stop it first
+    StopSampling();
+
+    if (m_listenfd != -1) {
+        // Stop the handlers before the state they use is destroyed
+        NetReactor::GetInstance().RunSync([this] {
+            auto& reactor = NetReactor::GetInstance();
+            reactor.Remove(m_listenfd);
+            reactor.Remove(m_ipcfd_r);
+            if (m_telemetryfd != -1) {
+                reactor.Remove(m_telemetryfd);
+            }
+            for (auto& conn : m_connList) {
+                reactor.Remove(conn->fd);
+            }
+
+            m_running = false;
+            m_connList.clear();
+        });
+
+        close(m_listenfd);
+    }
+
+    if (m_ipcfd_r != -1) {
+        close(m_ipcfd_r);
+    }
+    if (m_telemetryfd != -1) {
+        close(m_telemetryfd);
+    }
+}
+
+GraphHost::DatasetHandle GraphHost::RegisterDataset(const std::string& name,
+                                                  uint8_t encoding,
+                                                  float scale) {
+    std::lock_guard<std::mutex> lock(m_registerMutex);
+
+    auto i = m_graphList.find(name);
+    if (i != m_graphList.end()) {
+        return i->second;
+    }
+
+    size_t count = m_datasetCount.load(std::memory_order_relaxed);
+    if (count == k_maxDatasets) {
+        return k_invalidDataset;
+    }
+
+    // A zero scale would divide by zero when quantizing
+    if (scale == 0.f) {
+        scale = 1.f;
+    }
+
+    // Fill in the dataset before publishing the new count to the socket thread
+    m_datasets[count] = Dataset{name, encoding, scale};
+    m_graphList.emplace(name, count);
+    m_datasetCount.store(count + 1, std::memory_order_release);
+
+    return count;
+}
+
+bool GraphHost::GraphData(float value, DatasetHandle dataset) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::system_clock;
+
+    m_currentTime =
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count();
+
+    return GraphData(value, dataset, m_currentTime);
+}
+
+bool GraphHost::GraphData(float value, DatasetHandle dataset, uint64_t time) {
+    using std::chrono::steady_clock;
+
+    // Unregistered handles have no name or encoding for the socket thread
+    if (!m_running ||
+        dataset >= m_datasetCount.load(std::memory_order_acquire)) {
+        return false;
+    }
 
-    // Join to the other thread
-    m_thread.join();
+    auto start = steady_clock::now();
 
-    // Close file descriptors and clean up
-    close(m_ipcfd_r);
-    close(m_ipcfd_w);
+    bool queued = m_samples.Push(Sample{dataset, time, value});
+    if (queued) {
+        m_flushPending = true;
+    } else {
+        m_droppedSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    NotePublishTime(start);
+
+    return queued;
 }
 
-bool GraphHost::GraphData(float value, std::string dataset) {
+bool GraphHost::GraphData(float value, const std::string& dataset) {
+    return GraphData(value, RegisterDataset(dataset));
+}
+
+bool GraphHost::GraphSnapshot(std::initializer_list<SnapshotValue> values) {
     using std::chrono::duration_cast;
     using std::chrono::milliseconds;
+    using std::chrono::steady_clock;
     using std::chrono::system_clock;
 
     if (!m_running) {
         return false;
     }
 
-    // This will only work if ints are the same size as floats
-    static_assert(sizeof(float) == sizeof(uint32_t),
-                  "float isn't 32 bits long");
+    auto start = steady_clock::now();
 
     m_currentTime =
         duration_cast<milliseconds>(system_clock::now().time_since_epoch())
             .count();
 
-    auto i = m_graphList.find(dataset);
+    size_t datasetCount = m_datasetCount.load(std::memory_order_acquire);
+    m_snapshot.clear();
+    for (const auto& value : values) {
+        if (value.dataset < datasetCount) {
+            m_snapshot.emplace_back(
+                Sample{value.dataset, m_currentTime, value.value});
+        }
+    }
 
-    if (i == m_graphList.end()) {
-        m_graphList.emplace(dataset, m_graphList.size());
+    // The socket thread sees the whole batch at once, so it isn't split
+    bool queued = m_samples.Push(m_snapshot.data(), m_snapshot.size());
+    if (queued) {
+        m_flushPending = true;
+    } else {
+        m_droppedSamples.fetch_add(m_snapshot.size(),
+                                   std::memory_order_relaxed);
     }
 
-    ClientDataPacket packet;
-    packet.ID = k_clientDataPacket | i->second;
+    NotePublishTime(start);
 
-    // Change to network byte order
-    // Swap bytes in x, and copy into the payload struct
-    uint64_t xtmp;
-    std::memcpy(&xtmp, &m_currentTime, sizeof(xtmp));
-    xtmp = be64toh(xtmp);
-    std::memcpy(&packet.x, &xtmp, sizeof(xtmp));
+    return queued;
+}
 
-    // Swap bytes in y, and copy into the payload struct
-    uint32_t ytmp;
-    std::memcpy(&ytmp, &value, sizeof(ytmp));
-    ytmp = htonl(ytmp);
-    std::memcpy(&packet.y, &ytmp, sizeof(ytmp));
+GraphHost::DatasetHandle GraphHost::AddProbe(const std::string& name,
+                                             std::function<float()> probe) {
+    DatasetHandle dataset = RegisterDataset(name);
+    if (dataset == k_invalidDataset) {
+        return dataset;
+    }
 
-    m_mutex.lock();
+    std::lock_guard<std::mutex> lock(m_probeMutex);
+    m_probes.emplace_back(Probe{dataset, std::move(probe)});
+    return dataset;
+}
 
-    // Send the point to connected clients
-    for (auto& conn : m_connList) {
-        for (const auto& dataset_str : conn->dataSets) {
-            if (dataset_str == i->second) {
-                // Send the value off
-                conn->queueWrite(packet);
-            }
+void GraphHost::StopSampling() {
+    if (!m_samplerThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_samplerMutex);
+        m_stopSampling = true;
+    }
+    m_samplerCond.notify_one();
+
+    m_samplerThread.join();
+}
+
+GraphHost::DatasetHandle GraphHost::AddCapture(
+    DatasetHandle dataset, std::chrono::milliseconds preTrigger,
+    std::chrono::milliseconds postTrigger) {
+    if (dataset >= m_datasetCount.load(std::memory_order_acquire)) {
+        return k_invalidDataset;
+    }
+
+    // Checked and inserted under one hold so two callers can't both add
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+
+    // Capturing a capture would make sending its points recurse
+    for (const auto& capture : m_captures) {
+        if (capture.output == dataset) {
+            return k_invalidDataset;
+        }
+    }
+
+    // Registered datasets never change, so this can be read without locking
+    const Dataset& source = m_datasets[dataset];
+    DatasetHandle output = RegisterDataset(source.name + " (capture)",
+                                           source.encoding, source.scale);
+    if (output == k_invalidDataset) {
+        return output;
+    }
+
+    Capture capture;
+    capture.source = dataset;
+    capture.output = output;
+    capture.preTrigger = preTrigger.count();
+    capture.postTrigger = postTrigger.count();
+
+    /* Timestamps have millisecond resolution, so one point per millisecond
+     * fills the window without the ring growing while collecting.
+     */
+    capture.history.resize(capture.preTrigger + 1);
+
+    // Replace any capture the dataset already has
+    auto existing = std::find_if(
+        m_captures.begin(), m_captures.end(),
+        [&](const auto& other) { return other.source == dataset; });
+    if (existing != m_captures.end()) {
+        *existing = std::move(capture);
+    } else {
+        m_captures.emplace_back(std::move(capture));
+    }
+    return output;
+}
+
+void GraphHost::SetTriggerThreshold(DatasetHandle dataset, float threshold,
+                                    TriggerEdge edge) {
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    for (auto& capture : m_captures) {
+        if (capture.source == dataset) {
+            capture.hasThreshold = true;
+            capture.threshold = threshold;
+            capture.edge = edge;
         }
     }
+}
 
-    m_mutex.unlock();
+void GraphHost::Trigger() {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::system_clock;
+
+    m_triggerTime =
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count();
+    Wake();
+}
 
+bool GraphHost::AddStatistics(DatasetHandle dataset,
+                              std::chrono::milliseconds window,
+                              int statistics) {
+    if (dataset >= m_datasetCount.load(std::memory_order_acquire) ||
+        window.count() <= 0) {
+        return false;
+    }
+
+    WindowStatistics stats;
+    stats.source = dataset;
+    stats.window = window.count();
+
+    /* Registered datasets never change, so this can be read without locking.
+     * Outputs are always newer than their source, so statistics can't feed
+     * back into themselves.
+     */
+    const std::string& name = m_datasets[dataset].name;
+    std::pair<int, DatasetHandle*> outputs[] = {
+        {Mean, &stats.meanDataset},
+        {StdDev, &stats.stdDevDataset},
+        {Min, &stats.minDataset},
+        {Max, &stats.maxDataset},
+        {P99, &stats.p99Dataset}};
+    const char* suffixes[] = {" (mean)", " (stddev)", " (min)", " (max)",
+                              " (p99)"};
+    for (size_t i = 0; i < 5; i++) {
+        if (statistics & outputs[i].first) {
+            *outputs[i].second = RegisterDataset(name + suffixes[i]);
+            if (*outputs[i].second == k_invalidDataset) {
+                return false;
+            }
+        }
+    }
+
+    // Replace any statistics the dataset already has
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    auto existing = std::find_if(
+        m_statistics.begin(), m_statistics.end(),
+        [&](const auto& other) { return other.source == dataset; });
+    if (existing != m_statistics.end()) {
+        *existing = std::move(stats);
+    } else {
+        m_statistics.emplace_back(std::move(stats));
+    }
     return true;
 }
 
+void GraphHost::EnableTelemetry(std::chrono::milliseconds period) {
+    if (!m_telemetryRegistered) {
+        m_telemetry.loopTime = RegisterDataset("LG loop time (us)");
+        m_telemetry.publishTime = RegisterDataset("LG publish time (us)");
+        m_telemetry.droppedSamples = RegisterDataset("LG dropped points");
+        m_telemetry.clients = RegisterDataset("LG clients");
+        for (size_t i = 0; i < k_telemetryClients; i++) {
+            std::string prefix = "LG client " + std::to_string(i);
+            m_telemetry.clientRate[i] = RegisterDataset(prefix + " B/s");
+            m_telemetry.clientQueue[i] = RegisterDataset(prefix + " queue (B)");
+            m_telemetry.clientDrops[i] = RegisterDataset(prefix + " drops");
+        }
+        m_telemetryRegistered = true;
+    }
+
+    uint32_t milliseconds = std::max<int64_t>(period.count(), 0);
+    m_telemetryPeriod.store(milliseconds, std::memory_order_release);
+
+    // Without a listener, none of the host's handlers are registered
+    if (m_listenfd == -1) {
+        return;
+    }
+
+    if (m_telemetryfd == -1) {
+        m_telemetryfd = timerfd_create(CLOCK_MONOTONIC,
+                                       TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_telemetryfd == -1) {
+            std::perror("GraphHost: timerfd_create");
+            return;
+        }
+
+        NetReactor::GetInstance().Add(
+            m_telemetryfd, EPOLLIN,
+            [this](uint32_t) { OnWake(m_telemetryfd); });
+    }
+
+    // A zero interval disarms the timer
+    itimerspec spec{};
+    spec.it_interval.tv_sec = milliseconds / 1000;
+    spec.it_interval.tv_nsec = milliseconds % 1000 * 1000000;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(m_telemetryfd, 0, &spec, nullptr);
+}
+
+bool GraphHost::IsRunning() const { return m_running; }
+
 bool GraphHost::HasIntervalPassed() {
     using std::chrono::duration_cast;
     using std::chrono::milliseconds;
@@ -136,7 +461,40 @@ bool GraphHost::HasIntervalPassed() {
     return m_currentTime - m_lastTime > m_sendInterval;
 }
 
-void GraphHost::ResetInterval() { m_lastTime = m_currentTime; }
+void GraphHost::ResetInterval() {
+    m_lastTime = m_currentTime;
+    Flush();
+}
+
+void GraphHost::Flush() {
+    if (m_flushPending) {
+        // One wakeup sends everything queued since the last flush
+        Wake();
+        m_flushPending = false;
+        m_flushes.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+GraphHost::Stats GraphHost::GetStats() const {
+    Stats stats;
+
+    stats.queuedPackets = m_queuedPackets.load(std::memory_order_relaxed);
+    stats.flushes = m_flushes.load(std::memory_order_relaxed);
+    stats.sendCalls = m_sendCalls.load(std::memory_order_relaxed);
+    stats.sentBytes = m_sentBytes.load(std::memory_order_relaxed);
+    stats.droppedSamples = m_droppedSamples.load(std::memory_order_relaxed);
+    stats.droppedPackets = m_droppedPackets.load(std::memory_order_relaxed);
+    stats.maxPublishTime = std::chrono::nanoseconds{
+        m_maxPublishTime.load(std::memory_order_relaxed)};
+    stats.maxLoopTime = std::chrono::nanoseconds{
+        m_maxLoopTime.load(std::memory_order_relaxed)};
+    stats.sampleOverruns = m_sampleOverruns.load(std::memory_order_relaxed);
+    stats.recordedSamples = m_recordedSamples.load(std::memory_order_relaxed);
+    stats.failedRecordings =
+        m_failedRecordings.load(std::memory_order_relaxed);
+
+    return stats;
+}
 
 uint8_t GraphHost::packetID(uint8_t id) {
     // Masks two high-order bits
@@ -145,117 +503,244 @@ uint8_t GraphHost::packetID(uint8_t id) {
 
 uint8_t GraphHost::graphID(uint8_t id) {
     // Masks six low-order bits
-    return id & 0x2F;
+    return id & 0x3F;
+}
+
+size_t GraphHost::hostPacketLength(uint8_t id) {
+    switch (id) {
+        case k_hostHelloPacket:
+            return sizeof(HostHelloPacket);
+        case k_hostStatsPacket:
+            return sizeof(HostPacket);
+        case k_hostTimeSyncPacket:
+            return sizeof(HostTimeSyncPacket);
+        case k_hostConnectPacketV2:
+        case k_hostDisconnectPacketV2:
+            return sizeof(HostSubscribePacket);
+        case k_hostConnectRatePacket:
+            return sizeof(HostSubscribeRatePacket);
+    }
+
+    // Any other version 2 packet is unknown
+    if (packetID(id) == k_hostHelloPacket) {
+        return 0;
+    }
+
+    return sizeof(HostPacket);
 }
 
-void GraphHost::socket_threadmain() {
-    int listenfd;
-    int maxfd;
-    uint8_t ipccmd = 0;
+void GraphHost::StartSamplerThread(std::chrono::nanoseconds period) {
+    StopSampling();
 
-    fd_set readfds;
-    fd_set writefds;
-    fd_set errorfds;
+    m_stopSampling = false;
+    std::chrono::milliseconds sendInterval{m_sendInterval};
+    m_samplerThread = std::thread(
+        [this, period, sendInterval] {
+            sampler_threadmain(period, sendInterval);
+        });
+}
 
-    // Listen on a socket
-    listenfd = socket_listen(m_port, 0);
-    if (listenfd == -1) {
+void GraphHost::sampler_threadmain(std::chrono::nanoseconds period,
+                                   std::chrono::milliseconds sendInterval) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::steady_clock;
+    using std::chrono::system_clock;
+
+    if (period <= period.zero()) {
         return;
     }
 
-    // Set the running flag after we've finished initializing everything
-    m_running = true;
+    std::vector<Sample> batch;
+    bool flushPending = false;
 
-    while (ipccmd != 'x') {
-        // Clear the fdsets
-        FD_ZERO(&readfds);
-        FD_ZERO(&writefds);
-        FD_ZERO(&errorfds);
+    auto deadline = steady_clock::now();
+    auto nextFlush = deadline + sendInterval;
 
-        // Reset the maxfd
-        maxfd = listenfd;
+    std::unique_lock<std::mutex> lock(m_samplerMutex);
+    while (!m_stopSampling) {
+        uint64_t time =
+            duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+                .count();
 
-        // Add the file descriptors to the list
-        m_mutex.lock();
-        for (auto& conn : m_connList) {
-            if (maxfd < conn->fd) {
-                maxfd = conn->fd;
+        // Every probe in a tick gets the same timestamp
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> probeLock(m_probeMutex);
+            for (const auto& probe : m_probes) {
+                batch.emplace_back(Sample{probe.dataset, time, probe.read()});
             }
-            if (conn->selectflags & SocketConnection::Read) {
-                FD_SET(conn->fd, &readfds);
-            }
-            if (conn->selectflags & SocketConnection::Write) {
-                FD_SET(conn->fd, &writefds);
-            }
-            if (conn->selectflags & SocketConnection::Error) {
-                FD_SET(conn->fd, &errorfds);
+        }
+
+        if (!batch.empty()) {
+            if (m_probeSamples.Push(batch.data(), batch.size())) {
+                flushPending = true;
+            } else {
+                m_droppedSamples.fetch_add(batch.size(),
+                                           std::memory_order_relaxed);
             }
         }
-        m_mutex.unlock();
 
-        // Select on the listener fd
-        FD_SET(listenfd, &readfds);
+        auto now = steady_clock::now();
+        if (flushPending && now >= nextFlush) {
+            Wake();
+            m_flushes.fetch_add(1, std::memory_order_relaxed);
+            flushPending = false;
+            nextFlush = now + sendInterval;
+        }
 
-        // ipcfd will receive data when the thread needs to exit
-        FD_SET(m_ipcfd_r, &readfds);
+        /* Deadlines advance by whole periods from the start, so a late tick
+         * doesn't delay the ones after it. Ticks that were missed entirely are
+         * skipped instead of run back to back.
+         */
+        deadline += period;
+        if (now >= deadline) {
+            auto missed = (now - deadline) / period + 1;
+            m_sampleOverruns.fetch_add(missed, std::memory_order_relaxed);
+            deadline += missed * period;
+        }
 
-        // Select on the file descriptors
-        select(maxfd + 1, &readfds, &writefds, &errorfds, nullptr);
+        m_samplerCond.wait_until(lock, deadline,
+                                 [this] { return m_stopSampling; });
+    }
 
-        m_mutex.lock();
-        auto conn = m_connList.begin();
-        while (conn != m_connList.end()) {
-            if (FD_ISSET((*conn)->fd, &readfds)) {
-                // Handle reading
-                if (ReadPackets(conn->get()) == -1) {
-                    conn = m_connList.erase(conn);
-                    continue;
-                }
-            }
-            if (FD_ISSET((*conn)->fd, &writefds)) {
-                // Handle writing
-                (*conn)->writePackets();
-            }
-            if (FD_ISSET((*conn)->fd, &errorfds)) {
-                // Handle errors
-                conn = m_connList.erase(conn);
-                continue;
-            }
+    if (flushPending) {
+        Wake();
+    }
+}
 
-            conn++;
+void GraphHost::OnAccept() {
+    // Accept every pending connection
+    while (SocketConnection* conn = AcceptConnection(m_listenfd)) {
+        /* Connections are edge-triggered, so writable events are only
+         * reported after a send(2) returns EAGAIN and the socket drains. That
+         * avoids rearming EPOLLOUT per flush.
+         */
+        NetReactor::GetInstance().Add(
+            conn->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            [this, conn](uint32_t events) {
+                OnConnectionEvent(conn, events);
+            });
+    }
+}
+
+void GraphHost::OnWake(int fd) {
+    // Reading resets the eventfd or timerfd counter
+    uint64_t wakeups;
+    read(fd, &wakeups, sizeof(wakeups));
+
+    Service();
+}
+
+void GraphHost::OnConnectionEvent(SocketConnection* conn, uint32_t events) {
+    bool closed = events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP);
+
+    // Edge-triggered reads must drain the socket
+    if (!closed && (events & EPOLLIN)) {
+        int error;
+        while ((error = ReadPackets(conn)) > 0) {
         }
-        m_mutex.unlock();
+        closed = error == -1;
+    }
+    if (!closed && (events & EPOLLOUT)) {
+        closed = conn->writePackets() == -1;
+    }
 
-        // Check for listener condition
-        if (FD_ISSET(listenfd, &readfds)) {
-            // Accept connections
-            int fd = socket_accept(listenfd);
+    if (closed) {
+        CloseConnection(conn);
+        m_connList.erase(
+            std::find_if(m_connList.begin(), m_connList.end(),
+                         [&](auto& c) { return c.get() == conn; }));
+    }
 
-            if (fd != -1) {
-                // Disable Nagle's algorithm
-                int yes = 1;
-                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
-                           reinterpret_cast<char*>(&yes), sizeof(yes));
+    // Send replies queued by ReadPackets()
+    Service();
+}
 
-                m_mutex.lock();
-                // Add it to the list, this makes it a bit non-thread-safe
-                m_connList.emplace_back(
-                    std::make_unique<SocketConnection>(fd, m_ipcfd_w));
-                m_mutex.unlock();
-            }
+void GraphHost::Service() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Queue points published since the last wakeup
+    DispatchSamples();
+
+    /* Send queued data; sockets that fill up resume on EPOLLOUT. Clients that
+     * fell too far behind are closed.
+     */
+    auto conn = m_connList.begin();
+    while (conn != m_connList.end()) {
+        if ((*conn)->overflowed ||
+            (((*conn)->selectflags & SocketConnection::Write) &&
+             (*conn)->writePackets() == -1)) {
+            CloseConnection(conn->get());
+            conn = m_connList.erase(conn);
+        } else {
+            conn++;
         }
+    }
+
+    NoteLoopTime(std::chrono::steady_clock::now() - start);
+    UpdateStats();
+}
+
+SocketConnection* GraphHost::AcceptConnection(int listenfd) {
+    int fd = socket_accept(listenfd);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    // Disable Nagle's algorithm
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&yes),
+               sizeof(yes));
+
+    auto conn = std::make_unique<SocketConnection>(fd);
+
+    // Remember the client's address for GetClientStats()
+    sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getpeername(fd, reinterpret_cast<sockaddr*>(&addr), &addrlen) == 0) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        conn->address =
+            std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+    }
 
-        // Handle IPC commands
-        if (FD_ISSET(m_ipcfd_r, &readfds)) {
-            read(m_ipcfd_r, reinterpret_cast<char*>(&ipccmd), 1);
+    // Give the client the first free set of telemetry datasets
+    std::bitset<k_telemetryClients> usedSlots;
+    for (const auto& other : m_connList) {
+        if (other->telemetrySlot != -1) {
+            usedSlots.set(other->telemetrySlot);
+        }
+    }
+    for (size_t i = 0; i < k_telemetryClients; i++) {
+        if (!usedSlots.test(i)) {
+            conn->telemetrySlot = i;
+            break;
         }
     }
 
-    // We're done, clear the running flag and clean up
-    m_running = false;
+    m_connList.emplace_back(std::move(conn));
+    return m_connList.back().get();
+}
+
+void GraphHost::CloseConnection(SocketConnection* conn) {
+    // The descriptor is closed when the connection is destroyed
+    NetReactor::GetInstance().Remove(conn->fd);
 
-    // Close the listener file descriptor
-    close(listenfd);
+    // Keep the connection's counters in the totals
+    m_closedStats.queuedPackets += conn->queuedPackets;
+    m_closedStats.sendCalls += conn->sendCalls;
+    m_closedStats.sentBytes += conn->sentBytes;
+    m_closedStats.droppedPackets += conn->droppedPackets;
+}
+
+void GraphHost::Wake() {
+    if (m_ipcfd_w == -1) {
+        return;
+    }
+
+    uint64_t one = 1;
+    write(m_ipcfd_w, &one, sizeof(one));
 }
 
 /* Listens on a specified port (listenport), and returns the file descriptor
@@ -272,11 +757,9 @@ int GraphHost::socket_listen(int port, uint32_t s_addr) {
             throw -1;
         }
 
-// Allow rebinding to the socket later if the connection is interrupted
-#ifndef __VXWORKS__
+        // Allow rebinding to the socket later if the connection is interrupted
         int optval = 1;
         setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
-#endif
 
         // Zero out the serv_addr struct
         std::memset(&serv_addr, 0, sizeof(sockaddr_in));
@@ -296,6 +779,12 @@ int GraphHost::socket_listen(int port, uint32_t s_addr) {
         if (listen(sd, 5) != 0) {
             throw -1;
         }
+
+        // The epoll loop accepts until the backlog is empty
+        int flags = fcntl(sd, F_GETFL, 0);
+        if (flags == -1 || fcntl(sd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            throw -1;
+        }
     } catch (int e) {
         std::perror("");
         if (sd != -1) {
@@ -311,11 +800,7 @@ int GraphHost::socket_listen(int port, uint32_t s_addr) {
 }
 
 int GraphHost::socket_accept(int listenfd) {
-#ifdef __VXWORKS__
-    int clilen;
-#else
     unsigned int clilen;
-#endif
     sockaddr_in cli_addr;
 
     clilen = sizeof(cli_addr);
@@ -329,16 +814,13 @@ int GraphHost::socket_accept(int listenfd) {
 
         // Make sure that the file descriptor is valid
         if (new_fd == -1) {
+            // No more pending connections isn't an error
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return -1;
+            }
             throw -1;
         }
 
-#ifdef __VXWORKS__
-        // Set the socket non-blocking
-        int on = 1;
-        if (ioctl(new_fd, static_cast<int>(FIONBIO), on) == -1) {
-            throw -1;
-        }
-#else
         // Set the socket non-blocking
         int flags = fcntl(new_fd, F_GETFL, 0);
         if (flags == -1) {
@@ -348,7 +830,6 @@ int GraphHost::socket_accept(int listenfd) {
         if (fcntl(new_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
             throw -1;
         }
-#endif
     } catch (int e) {
         std::perror("");
         if (new_fd != -1) {
@@ -361,52 +842,871 @@ int GraphHost::socket_accept(int listenfd) {
 }
 
 int GraphHost::ReadPackets(SocketConnection* conn) {
-    int error;
-    uint8_t id;
-
-    error = conn->recvData(reinterpret_cast<char*>(&id), 1);
-    if (error == 0 || (error == -1 && errno != EAGAIN)) {
-        return -1;
+    int error = conn->recvData(&conn->recvbuf[conn->recvlen],
+                               sizeof(conn->recvbuf) - conn->recvlen);
+    if (error <= 0) {
+        return error;
     }
+    conn->recvlen += error;
 
-    switch (packetID(id)) {
-        case k_hostConnectPacket:
-            // Start sending data for the graph specified by the ID
-            if (std::find(conn->dataSets.begin(), conn->dataSets.end(),
-                          graphID(id)) == conn->dataSets.end()) {
-                conn->dataSets.push_back(graphID(id));
-            }
-            break;
-        case k_hostDisconnectPacket:
-            // Stop sending data for the graph specified by the ID
-            conn->dataSets.erase(std::remove(conn->dataSets.begin(),
-                                             conn->dataSets.end(), graphID(id)),
-                                 conn->dataSets.end());
+    // Time sync requests are stamped as close to their arrival as possible
+    uint64_t receiveTime = SystemMicroseconds();
+
+    size_t pos = 0;
+    while (pos < conn->recvlen) {
+        const char* packet = &conn->recvbuf[pos];
+        uint8_t id = packet[0];
+
+        size_t length = hostPacketLength(id);
+        if (length == 0) {
+            return -1;
+        }
+        if (conn->recvlen - pos < length) {
+            // Wait for the rest of the packet
             break;
-        case k_hostListPacket:
-            for (auto& graph : m_graphList) {
-                if (m_buf.length() < 1 + 1 + graph.first.length() + 1) {
-                    m_buf.resize(1 + 1 + graph.first.length() + 1);
+        }
+        pos += length;
+
+        /* The other version 2 packets are ignored until the client says hello.
+         * A version 1 client couldn't receive the replies or the points of
+         * datasets it can't address.
+         */
+        if (conn->version < 2 && packetID(id) == k_hostHelloPacket &&
+            id != k_hostHelloPacket) {
+            continue;
+        }
+
+        switch (id) {
+            case k_hostHelloPacket: {
+                HostHelloPacket hello;
+                std::memcpy(&hello, packet, sizeof(hello));
+
+                // Answer with the highest version both sides support
+                ClientHelloPacket reply;
+                reply.ID = k_clientHelloPacket;
+                reply.version = std::min(hello.version, k_protocolVersion);
+                conn->version = reply.version < 2 ? 1 : 2;
+                conn->queueWrite(reply, false);
+                continue;
+            }
+            case k_hostStatsPacket:
+                SendStats(conn);
+                continue;
+            case k_hostTimeSyncPacket: {
+                HostTimeSyncPacket request;
+                std::memcpy(&request, packet, sizeof(request));
+
+                // The client's time is echoed in its original byte order
+                ClientTimeSyncPacket reply;
+                reply.ID = k_clientTimeSyncPacket;
+                reply.clientTime = request.clientTime;
+                reply.receiveTime = be64toh(receiveTime);
+                reply.transmitTime = be64toh(SystemMicroseconds());
+                conn->queueWrite(reply, false);
+
+                // Send right away so the transmit time stays accurate
+                if (conn->writePackets() == -1) {
+                    return -1;
+                }
+                continue;
+            }
+            case k_hostConnectPacketV2:
+            case k_hostDisconnectPacketV2: {
+                HostSubscribePacket subscribe;
+                std::memcpy(&subscribe, packet, sizeof(subscribe));
+
+                size_t dataset = ntohs(subscribe.dataset);
+                if (dataset < k_maxDatasets) {
+                    conn->dataSets.set(dataset, id == k_hostConnectPacketV2);
+                    conn->decimated.reset(dataset);
+                    conn->buckets.erase(dataset);
+                }
+                continue;
+            }
+            case k_hostConnectRatePacket: {
+                HostSubscribeRatePacket subscribe;
+                std::memcpy(&subscribe, packet, sizeof(subscribe));
+
+                size_t dataset = ntohs(subscribe.dataset);
+                uint16_t rate = ntohs(subscribe.rate);
+                if (dataset >= k_maxDatasets) {
+                    continue;
                 }
 
-                m_buf[0] = k_clientListPacket | graph.second;
-                m_buf[1] = graph.first.length();
-                std::strncpy(&m_buf[2], graph.first.c_str(),
-                             graph.first.length());
+                conn->dataSets.set(dataset);
 
-                // Is this the last element in the list?
-                if (static_cast<size_t>(graph.second + 1) ==
-                    m_graphList.size()) {
-                    m_buf[2 + m_buf[1]] = 1;
+                // A rate of zero requests every point
+                if (rate == 0) {
+                    conn->decimated.reset(dataset);
+                    conn->buckets.erase(dataset);
                 } else {
-                    m_buf[2 + m_buf[1]] = 0;
+                    conn->decimated.set(dataset);
+
+                    SocketConnection::Bucket bucket;
+                    bucket.period = std::max(1000 / rate, 1);
+                    conn->buckets[dataset] = bucket;
                 }
+                continue;
+            }
+        }
+
+        switch (packetID(id)) {
+            case k_hostConnectPacket:
+                // Start sending data for the graph specified by the ID
+                conn->dataSets.set(graphID(id));
+                break;
+            case k_hostDisconnectPacket:
+                // Stop sending data for the graph specified by the ID
+                conn->dataSets.reset(graphID(id));
+                break;
+            case k_hostListPacket:
+                SendDatasetList(conn);
+                break;
+        }
+    }
+
+    // Keep any partial packet for the next read
+    conn->recvlen -= pos;
+    std::memmove(conn->recvbuf, &conn->recvbuf[pos], conn->recvlen);
+
+    return 1;
+}
+
+void GraphHost::SendDatasetList(SocketConnection* conn) {
+    UpdateDatasetLists();
+
+    // Each list is queued as one write that's never dropped
+    if (conn->version >= 2) {
+        conn->queueWrite(m_listV2.c_str(), m_listV2.length(), false);
+    } else if (!m_listV1.empty()) {
+        conn->queueWrite(m_listV1.c_str(), m_listV1.length(), false);
+    }
+}
+
+void GraphHost::UpdateDatasetLists() {
+    size_t count = m_datasetCount.load(std::memory_order_acquire);
+
+    if (m_listV2.empty()) {
+        ClientListHeaderV2 header;
+        header.ID = k_clientListPacketV2;
+        header.count = 0;
+        m_listV2.assign(reinterpret_cast<char*>(&header), sizeof(header));
+    }
+
+    for (size_t i = m_listCount; i < count; i++) {
+        const Dataset& dataset = m_datasets[i];
+        uint8_t length = std::min<size_t>(dataset.name.length(), 255);
+
+        uint32_t scale;
+        std::memcpy(&scale, &dataset.scale, sizeof(scale));
+        scale = htonl(scale);
+
+        ClientListEntryV2 entry;
+        entry.dataset = htons(i);
+        entry.encoding = dataset.encoding;
+        std::memcpy(&entry.scale, &scale, sizeof(scale));
+        entry.length = length;
+
+        m_listV2.append(reinterpret_cast<char*>(&entry), sizeof(entry));
+        m_listV2.append(dataset.name, 0, length);
+
+        // Version 1 clients can only address the first datasets
+        if (i < k_maxDatasetsV1) {
+            // The previous packet's last byte marks the end of the list
+            if (!m_listV1.empty()) {
+                m_listV1.back() = 0;
+            }
+
+            m_listV1 += static_cast<char>(k_clientListPacket | i);
+            m_listV1 += static_cast<char>(length);
+            m_listV1.append(dataset.name, 0, length);
+            m_listV1 += static_cast<char>(1);
+        }
+    }
+
+    uint16_t listCount = htons(count);
+    std::memcpy(&m_listV2[offsetof(ClientListHeaderV2, count)], &listCount,
+                sizeof(listCount));
+
+    m_listCount = count;
+}
+
+void GraphHost::SendStats(SocketConnection* conn) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
+
+    // Clamps a counter to the width of its field
+    auto clamp32 = [](uint64_t value) {
+        return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+    };
+
+    auto loopTime = duration_cast<microseconds>(
+        nanoseconds{m_maxLoopTime.load(std::memory_order_relaxed)});
+    auto publishTime = duration_cast<microseconds>(
+        nanoseconds{m_maxPublishTime.load(std::memory_order_relaxed)});
+
+    ClientStatsPacket packet;
+    packet.ID = k_clientStatsPacket;
+    packet.clients = htons(std::min<size_t>(m_connList.size(), UINT16_MAX));
+    packet.queuedBytes = htonl(clamp32(conn->queuedBytes()));
+    packet.bytesPerSecond = htonl(clamp32(conn->bytesPerSecond));
+    packet.sentBytes = be64toh(conn->sentBytes);
+    packet.droppedPackets = be64toh(conn->droppedPackets);
+    packet.droppedSamples =
+        be64toh(m_droppedSamples.load(std::memory_order_relaxed));
+    packet.maxLoopTime = htonl(clamp32(loopTime.count()));
+    packet.maxPublishTime = htonl(clamp32(publishTime.count()));
+
+    conn->queueWrite(packet, false);
+}
+
+void GraphHost::DispatchSamples() {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::system_clock;
+
+    // Apply the latest queue limits before queueing anything
+    for (auto& conn : m_connList) {
+        conn->maxBytes = m_maxQueueBytes;
+        conn->maxPackets = m_maxQueuePackets;
+        conn->overflowPolicy = m_overflowPolicy;
+    }
+
+    // Held while popping so a recording can't stop partway through
+    std::lock_guard<std::mutex> recorderLock(m_recorderMutex);
+    std::lock_guard<std::mutex> ringLock(m_ringMutex);
+    std::lock_guard<std::mutex> captureLock(m_captureMutex);
+    std::lock_guard<std::mutex> statisticsLock(m_statisticsMutex);
+
+    // Fire captures triggered by Trigger() since the last wakeup
+    uint64_t triggerTime = m_triggerTime.exchange(0);
+    if (triggerTime != 0) {
+        for (auto& capture : m_captures) {
+            if (!capture.triggered) {
+                FireCapture(capture, triggerTime);
+            }
+        }
+    }
+
+    // Drain each queue in turn so points stay in time order within frames
+    Sample sample;
+    uint64_t newestTime = 0;
+    while (m_samples.Pop(sample)) {
+        newestTime = std::max(newestTime, sample.time);
+        DispatchSample(sample);
+    }
+    while (m_probeSamples.Pop(sample)) {
+        newestTime = std::max(newestTime, sample.time);
+        DispatchSample(sample);
+    }
+
+    uint64_t now =
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count();
+
+    // Without new points, the samples' clock keeps pace with the system clock
+    if (newestTime != 0) {
+        m_sampleClockOffset = static_cast<int64_t>(newestTime - now);
+    }
+    uint64_t sampleNow = now + m_sampleClockOffset;
+
+    uint32_t telemetryPeriod =
+        m_telemetryPeriod.load(std::memory_order_acquire);
+    if (telemetryPeriod != 0 && now >= m_nextTelemetry) {
+        PublishTelemetry(now);
 
-                // Queue the datagram for writing
-                conn->queueWrite(m_buf.c_str(),
-                                 1 + 1 + graph.first.length() + 1);
+        // Stay on the timer's schedule unless a whole period was missed
+        m_nextTelemetry += telemetryPeriod;
+        if (m_nextTelemetry <= now) {
+            m_nextTelemetry = now + telemetryPeriod;
+        }
+    }
+
+    // Close windows that ended, even if no newer point arrived
+    for (auto& statistics : m_statistics) {
+        if (statistics.count > 0 &&
+            sampleNow >= statistics.start + statistics.window) {
+            EmitStatistics(statistics);
+        }
+    }
+
+    // Send buckets whose period has ended, even if no newer point arrived
+    for (auto& conn : m_connList) {
+        for (auto& bucket : conn->buckets) {
+            if (!bucket.second.empty &&
+                sampleNow >= bucket.second.start + bucket.second.period) {
+                EmitBucket(conn.get(), bucket.first, bucket.second);
             }
+        }
+
+        FinishFrame(conn.get());
+    }
+}
+
+void GraphHost::DispatchSample(const Sample& sample) {
+    // This will only work if ints are the same size as floats
+    static_assert(sizeof(float) == sizeof(uint32_t),
+                  "float isn't 32 bits long");
+
+    /* DispatchSamples() holds m_recorderMutex, m_ringMutex, m_captureMutex
+     * and m_statisticsMutex
+     */
+    if (m_recorder != nullptr) {
+        RecordSample(sample);
+    }
+    if (m_ring != nullptr) {
+        PublishToRing(sample);
+    }
+    if (!m_captures.empty()) {
+        CapturePoint(sample);
+    }
+    if (!m_statistics.empty()) {
+        AccumulateStatistics(sample);
+    }
+
+    ClientDataPacket packet;
+    packet.ID = k_clientDataPacket | sample.dataset;
+
+    // Change to network byte order
+    // Swap bytes in x, and copy into the payload struct
+    uint64_t xtmp;
+    std::memcpy(&xtmp, &sample.time, sizeof(xtmp));
+    xtmp = be64toh(xtmp);
+    std::memcpy(&packet.x, &xtmp, sizeof(xtmp));
+
+    // Swap bytes in y, and copy into the payload struct
+    uint32_t ytmp;
+    std::memcpy(&ytmp, &sample.value, sizeof(ytmp));
+    ytmp = htonl(ytmp);
+    std::memcpy(&packet.y, &ytmp, sizeof(ytmp));
+
+    // Value encoded for version 2 clients
+    char value[4];
+    size_t valueLength = EncodeValue(value, sample.dataset, sample.value);
+
+    // Queue the point for subscribed clients
+    for (auto& conn : m_connList) {
+        if (!conn->dataSets.test(sample.dataset)) {
+            continue;
+        }
+
+        if (conn->version < 2) {
+            // The ID would overflow into the packet type bits
+            if (sample.dataset < k_maxDatasetsV1) {
+                conn->queueWrite(packet);
+            }
+        } else if (conn->decimated.test(sample.dataset)) {
+            AddToBucket(conn.get(), sample.dataset,
+                        {sample.time, sample.value});
+        } else {
+            AppendToFrame(conn.get(), sample.dataset, sample.time, value,
+                          valueLength);
+        }
+    }
+}
+
+void GraphHost::CapturePoint(const Sample& sample) {
+    for (auto& capture : m_captures) {
+        if (capture.source != sample.dataset) {
+            continue;
+        }
+
+        if (capture.triggered) {
+            if (sample.time <= capture.endTime) {
+                DispatchSample(Sample{capture.output, sample.time,
+                                      sample.value});
+                continue;
+            }
+
+            // The window after the trigger ended; start collecting again
+            capture.triggered = false;
+        }
+
+        bool crossed = false;
+        if (capture.hasThreshold && capture.historySize != 0) {
+            float last = capture.HistoryAt(capture.historySize - 1).value;
+            bool rising = last < capture.threshold &&
+                          sample.value >= capture.threshold;
+            bool falling = last > capture.threshold &&
+                           sample.value <= capture.threshold;
+            crossed = (capture.edge != TriggerEdge::Falling && rising) ||
+                      (capture.edge != TriggerEdge::Rising && falling);
+        }
+
+        // Drop points that left the window before making room for this one
+        while (capture.historySize != 0 &&
+               capture.HistoryAt(0).time + capture.preTrigger < sample.time) {
+            capture.historyStart =
+                (capture.historyStart + 1) % capture.history.size();
+            capture.historySize--;
+        }
+
+        // Only grows when more than one point arrives per millisecond
+        if (capture.historySize == capture.history.size()) {
+            std::vector<SocketConnection::Point> history(
+                capture.history.size() * 2);
+            for (size_t i = 0; i < capture.historySize; i++) {
+                history[i] = capture.HistoryAt(i);
+            }
+            capture.history = std::move(history);
+            capture.historyStart = 0;
+        }
+        capture.HistoryAt(capture.historySize) = {sample.time, sample.value};
+        capture.historySize++;
+
+        if (crossed) {
+            FireCapture(capture, sample.time);
+        }
+    }
+}
+
+void GraphHost::FireCapture(Capture& capture, uint64_t time) {
+    capture.triggered = true;
+    capture.endTime = time + capture.postTrigger;
+
+    // The capture dataset can't be a capture source, so this doesn't recurse
+    for (size_t i = 0; i < capture.historySize; i++) {
+        const auto& point = capture.HistoryAt(i);
+        DispatchSample(Sample{capture.output, point.time, point.value});
+    }
+    capture.historyStart = 0;
+    capture.historySize = 0;
+}
+
+void GraphHost::AccumulateStatistics(const Sample& sample) {
+    for (auto& statistics : m_statistics) {
+        if (statistics.source != sample.dataset) {
+            continue;
+        }
+
+        uint64_t start = sample.time - sample.time % statistics.window;
+        if (statistics.count > 0 && start != statistics.start) {
+            EmitStatistics(statistics);
+        }
+        statistics.start = start;
+
+        statistics.count++;
+        double delta = sample.value - statistics.mean;
+        statistics.mean += delta / statistics.count;
+        statistics.m2 += delta * (sample.value - statistics.mean);
+
+        if (statistics.count == 1) {
+            statistics.minValue = sample.value;
+            statistics.maxValue = sample.value;
+        } else {
+            statistics.minValue = std::min(statistics.minValue, sample.value);
+            statistics.maxValue = std::max(statistics.maxValue, sample.value);
+        }
+
+        if (statistics.p99Dataset != k_invalidDataset) {
+            statistics.values.emplace_back(sample.value);
+        }
+    }
+}
+
+void GraphHost::EmitStatistics(WindowStatistics& statistics) {
+    uint64_t time = statistics.start + statistics.window;
+
+    // Outputs are never statistics sources of this entry, so this is safe
+    auto emit = [&](DatasetHandle dataset, float value) {
+        if (dataset != k_invalidDataset) {
+            DispatchSample(Sample{dataset, time, value});
+        }
+    };
+
+    emit(statistics.meanDataset, statistics.mean);
+    emit(statistics.stdDevDataset,
+         std::sqrt(statistics.m2 / statistics.count));
+    emit(statistics.minDataset, statistics.minValue);
+    emit(statistics.maxDataset, statistics.maxValue);
+
+    if (!statistics.values.empty()) {
+        // Nearest rank, so the value is one that was actually seen
+        size_t rank = std::ceil(0.99 * statistics.values.size()) - 1;
+        std::nth_element(statistics.values.begin(),
+                         statistics.values.begin() + rank,
+                         statistics.values.end());
+        emit(statistics.p99Dataset, statistics.values[rank]);
+    }
+
+    // Keep the vector's storage for the next window
+    statistics.values.clear();
+    statistics.count = 0;
+    statistics.mean = 0.0;
+    statistics.m2 = 0.0;
+}
+
+void GraphHost::RecordSample(const Sample& sample) {
+    /* The sample's dataset was registered before it was queued, so reloading
+     * the count is enough to find its name
+     */
+    if (sample.dataset >= m_recorder->DatasetCount()) {
+        size_t count = m_datasetCount.load(std::memory_order_acquire);
+        for (size_t i = m_recorder->DatasetCount(); i < count; i++) {
+            m_recorder->AddDataset(m_datasets[i].name);
+        }
+    }
+
+    m_recorder->Record(sample.dataset, sample.time, sample.value);
+}
+
+void GraphHost::PublishToRing(const Sample& sample) {
+    // Name datasets the same way RecordSample() does
+    if (sample.dataset >= m_ring->DatasetCount()) {
+        size_t count = m_datasetCount.load(std::memory_order_acquire);
+        for (size_t i = m_ring->DatasetCount(); i < count; i++) {
+            m_ring->AddDataset(m_datasets[i].name);
+        }
+    }
+
+    m_ring->Write(sample.dataset, sample.time, sample.value);
+}
+
+void GraphHost::PublishTelemetry(uint64_t time) {
+    using std::chrono::duration;
+    using std::chrono::nanoseconds;
+
+    // Registration fails once k_maxDatasets datasets exist
+    auto publish = [&](DatasetHandle dataset, float value) {
+        if (dataset != k_invalidDataset) {
+            DispatchSample(Sample{dataset, time, value});
+        }
+    };
+
+    nanoseconds publishTime{
+        m_periodPublishTime.exchange(0, std::memory_order_relaxed)};
+    uint64_t droppedSamples = m_droppedSamples.load(std::memory_order_relaxed);
+
+    publish(m_telemetry.loopTime,
+            duration<float, std::micro>(m_periodLoopTime).count());
+    publish(m_telemetry.publishTime,
+            duration<float, std::micro>(publishTime).count());
+    publish(m_telemetry.droppedSamples,
+            droppedSamples - m_telemetryDroppedSamples);
+    publish(m_telemetry.clients, m_connList.size());
+
+    m_periodLoopTime = m_periodLoopTime.zero();
+    m_telemetryDroppedSamples = droppedSamples;
+
+    for (auto& conn : m_connList) {
+        if (conn->telemetrySlot == -1) {
+            continue;
+        }
+
+        size_t slot = conn->telemetrySlot;
+        publish(m_telemetry.clientRate[slot], conn->bytesPerSecond);
+        publish(m_telemetry.clientQueue[slot], conn->queuedBytes());
+        publish(m_telemetry.clientDrops[slot],
+                conn->droppedPackets - conn->telemetryDroppedPackets);
+        conn->telemetryDroppedPackets = conn->droppedPackets;
+    }
+}
+
+void GraphHost::NotePublishTime(std::chrono::steady_clock::time_point start) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    using std::chrono::steady_clock;
+
+    int64_t elapsed =
+        duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    /* A load and store would let a publish from another thread overwrite a
+     * larger maximum, so update it with a CAS like the period's maximum
+     */
+    int64_t max = m_maxPublishTime.load(std::memory_order_relaxed);
+    while (elapsed > max && !m_maxPublishTime.compare_exchange_weak(
+                                max, elapsed, std::memory_order_relaxed)) {
+    }
+
+    // The socket thread resets the period's maximum
+    int64_t periodMax = m_periodPublishTime.load(std::memory_order_relaxed);
+    while (elapsed > periodMax &&
+           !m_periodPublishTime.compare_exchange_weak(
+               periodMax, elapsed, std::memory_order_relaxed)) {
+    }
+}
+
+void GraphHost::NoteLoopTime(std::chrono::steady_clock::duration elapsed) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    m_periodLoopTime = std::max(m_periodLoopTime, elapsed);
+
+    // Only the socket thread writes the maximum
+    int64_t ns = duration_cast<nanoseconds>(elapsed).count();
+    if (ns > m_maxLoopTime.load(std::memory_order_relaxed)) {
+        m_maxLoopTime.store(ns, std::memory_order_relaxed);
+    }
+}
+
+size_t GraphHost::EncodeValue(char* buf, DatasetHandle dataset, float value) {
+    const Dataset& info = m_datasets[dataset];
+
+    if (info.encoding == k_encodingFloat16) {
+        uint16_t half = htons(FloatToHalf(value));
+        std::memcpy(buf, &half, sizeof(half));
+        return sizeof(half);
+    } else if (info.encoding == k_encodingQuantized16) {
+        float scaled = std::round(value / info.scale);
+        scaled = std::max(-32768.f, std::min(scaled, 32767.f));
+
+        uint16_t quantized = htons(static_cast<int16_t>(scaled));
+        std::memcpy(buf, &quantized, sizeof(quantized));
+        return sizeof(quantized);
+    } else {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits = htonl(bits);
+        std::memcpy(buf, &bits, sizeof(bits));
+        return sizeof(bits);
+    }
+}
+
+void GraphHost::AppendToFrame(SocketConnection* conn, DatasetHandle dataset,
+                              uint64_t time, const char* value,
+                              size_t length) {
+    // ID, longest varint for a 64-bit delta, and value
+    char sample[2 + 10 + 4];
+    size_t sampleLength = 0;
+
+    /* Deltas are unsigned, so a point older than the frame's base time (from a
+     * late bucket or a clock step backward) starts a new frame
+     */
+    if (!conn->frame.empty() &&
+        (time < conn->frameBaseTime ||
+         conn->frame.length() + sizeof(sample) >
+             sizeof(ClientFrameHeader) + k_maxFrameLength)) {
+        FinishFrame(conn);
+    }
+
+    if (conn->frame.empty()) {
+        // The length is filled in by FinishFrame()
+        ClientFrameHeader header;
+        header.ID = k_clientFramePacket;
+        header.length = 0;
+
+        /* Buckets close after points newer than theirs were framed, so start
+         * the frame one bucket period early to keep their points in it
+         */
+        uint64_t frameBaseTime = time;
+        for (const auto& bucket : conn->buckets) {
+            frameBaseTime = std::min<uint64_t>(
+                frameBaseTime,
+                time - std::min<uint64_t>(time, bucket.second.period));
+        }
+
+        uint64_t baseTime = be64toh(frameBaseTime);
+        std::memcpy(&header.baseTime, &baseTime, sizeof(baseTime));
+
+        conn->frame.append(reinterpret_cast<char*>(&header), sizeof(header));
+        conn->frameBaseTime = frameBaseTime;
+    }
+
+    uint16_t id = htons(dataset);
+    std::memcpy(&sample[sampleLength], &id, sizeof(id));
+    sampleLength += sizeof(id);
+
+    // Time since the frame's base time as a little-endian base-128 varint
+    uint64_t delta = time - conn->frameBaseTime;
+    while (delta >= 0x80) {
+        sample[sampleLength++] = static_cast<char>(delta | 0x80);
+        delta >>= 7;
+    }
+    sample[sampleLength++] = static_cast<char>(delta);
+
+    std::memcpy(&sample[sampleLength], value, length);
+    sampleLength += length;
+
+    conn->frame.append(sample, sampleLength);
+}
+
+void GraphHost::FinishFrame(SocketConnection* conn) {
+    if (conn->frame.empty()) {
+        return;
+    }
+
+    uint16_t length = htons(conn->frame.length() - sizeof(ClientFrameHeader));
+    std::memcpy(&conn->frame[offsetof(ClientFrameHeader, length)], &length,
+                sizeof(length));
+
+    conn->queueWrite(conn->frame.c_str(), conn->frame.length());
+    conn->frame.clear();
+}
+
+void GraphHost::AddToBucket(SocketConnection* conn, DatasetHandle dataset,
+                            const SocketConnection::Point& point) {
+    auto& bucket = conn->buckets[dataset];
+
+    if (!bucket.empty && point.time >= bucket.start + bucket.period) {
+        EmitBucket(conn, dataset, bucket);
+    }
+
+    if (bucket.empty) {
+        // Align buckets to multiples of the period so clients agree on them
+        bucket.start = point.time - point.time % bucket.period;
+        bucket.empty = false;
+        bucket.min = point;
+        bucket.max = point;
+    } else if (point.value < bucket.min.value) {
+        bucket.min = point;
+    } else if (point.value > bucket.max.value) {
+        bucket.max = point;
+    }
+    bucket.last = point;
+}
+
+void GraphHost::EmitBucket(SocketConnection* conn, DatasetHandle dataset,
+                           SocketConnection::Bucket& bucket) {
+    SocketConnection::Point points[3] = {bucket.min, bucket.max, bucket.last};
+    std::sort(std::begin(points), std::end(points),
+              [](const auto& lhs, const auto& rhs) {
+                  return lhs.time < rhs.time;
+              });
+
+    char value[4];
+    for (size_t i = 0; i < 3; i++) {
+        // The same point can be more than one of min, max and last
+        if (i > 0 && points[i].time == points[i - 1].time &&
+            points[i].value == points[i - 1].value) {
+            continue;
+        }
+
+        size_t length = EncodeValue(value, dataset, points[i].value);
+        AppendToFrame(conn, dataset, points[i].time, value, length);
+    }
+
+    bucket.empty = true;
+}
+
+void GraphHost::UpdateStats() {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+    using std::chrono::steady_clock;
+
+    auto now = steady_clock::now();
+
+    Stats stats = m_closedStats;
+    for (auto& conn : m_connList) {
+        // Measure each client's send rate over windows of about a second
+        auto window = duration_cast<milliseconds>(now - conn->rateStart);
+        if (window >= seconds{1}) {
+            conn->bytesPerSecond =
+                (conn->sentBytes - conn->rateSentBytes) * 1000 / window.count();
+            conn->rateSentBytes = conn->sentBytes;
+            conn->rateStart = now;
+        }
+
+        stats.queuedPackets += conn->queuedPackets;
+        stats.sendCalls += conn->sendCalls;
+        stats.sentBytes += conn->sentBytes;
+        stats.droppedPackets += conn->droppedPackets;
+    }
+
+    m_queuedPackets.store(stats.queuedPackets, std::memory_order_relaxed);
+    m_sendCalls.store(stats.sendCalls, std::memory_order_relaxed);
+    m_sentBytes.store(stats.sentBytes, std::memory_order_relaxed);
+    m_droppedPackets.store(stats.droppedPackets, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(m_recorderMutex);
+        if (m_recorder != nullptr) {
+            m_recordedSamples.store(m_recorder->RecordedSamples(),
+                                    std::memory_order_relaxed);
+            m_failedRecordings.store(m_recorder->FailedSamples(),
+                                     std::memory_order_relaxed);
+        }
+    }
+
+    // Reuse the entries so their strings keep their storage
+    std::lock_guard<std::mutex> lock(m_clientStatsMutex);
+    m_clientStats.resize(m_connList.size());
+    for (size_t i = 0; i < m_connList.size(); i++) {
+        const auto& conn = m_connList[i];
+        auto& client = m_clientStats[i];
+
+        client.address = conn->address;
+        client.queuedBytes = conn->queuedBytes();
+        client.queuedPackets = conn->queuedCount();
+        client.maxQueuedBytes = conn->maxQueuedBytes;
+        client.sentBytes = conn->sentBytes;
+        client.bytesPerSecond = conn->bytesPerSecond;
+        client.droppedPackets = conn->droppedPackets;
+        client.droppedBytes = conn->droppedBytes;
+        client.maxSendLatency =
+            duration_cast<microseconds>(conn->maxSendLatency);
+        if (conn->sentPackets > 0) {
+            client.averageSendLatency = duration_cast<microseconds>(
+                conn->totalSendLatency / conn->sentPackets);
+        } else {
+            client.averageSendLatency = microseconds{0};
+        }
+    }
+}
+
+void GraphHost::SetQueueLimits(size_t maxBytes, size_t maxPackets,
+                               SocketConnection::OverflowPolicy policy) {
+    m_maxQueueBytes = maxBytes;
+    m_maxQueuePackets = maxPackets;
+    m_overflowPolicy = policy;
+}
+
+std::vector<GraphHost::ClientStats> GraphHost::GetClientStats() const {
+    std::lock_guard<std::mutex> lock(m_clientStatsMutex);
+    return m_clientStats;
+}
+
+bool GraphHost::StartRecording(const std::string& directory, size_t fileSize,
+                               size_t maxFiles) {
+    // Close the old recording before scanning the directory for the new one
+    StopRecording();
+
+    auto recorder =
+        std::make_unique<GraphRecorder>(directory, fileSize, maxFiles);
+    if (!recorder->IsOpen()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_recorderMutex);
+    m_recorder = std::move(recorder);
+    return true;
+}
+
+void GraphHost::StopRecording() {
+    std::unique_ptr<GraphRecorder> recorder;
+
+    {
+        std::lock_guard<std::mutex> lock(m_recorderMutex);
+        recorder = std::move(m_recorder);
+    }
+
+    // The file is closed here, without blocking the socket thread
+}
+
+bool GraphHost::StartSharedMemory(const std::string& name, size_t capacity) {
+    // Remove the old ring first in case it has the same name
+    StopSharedMemory();
+
+    auto ring =
+        std::make_unique<GraphRingWriter>(name, capacity, k_maxDatasets);
+    if (!ring->IsOpen()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    m_ring = std::move(ring);
+    return true;
+}
+
+void GraphHost::StopSharedMemory() {
+    std::unique_ptr<GraphRingWriter> ring;
+
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        ring = std::move(m_ring);
     }
 
-    return 0;
+    // The ring is unmapped here, without blocking the socket thread
 }
@@ -2,10 +2,15 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -13,6 +18,9 @@
 #include <thread>
 #include <vector>
 
+#include "../SpscQueue.hpp"
+#include "GraphRecorder.hpp"
+#include "GraphRingWriter.hpp"
 #include "SocketConnection.hpp"
 
 /**
@@ -23,19 +31,71 @@
  * The GraphHost interface is started upon object initialization.
  *
  * Call graphData() to send data over the network to a LiveGrapher client.
+ * Datasets can be registered ahead of time with RegisterDataset(), which
+ * returns a handle that GraphData() accepts in place of the dataset name. This
+ * avoids looking up the name every time a point is sent.
+ *
+ * Clients that negotiate version 2 of the protocol receive each flush as one
+ * compact frame, and may subscribe to any of the k_maxDatasets datasets.
+ * Version 1 clients only see the first 64 datasets.
+ *
+ * Version 2 clients may also subscribe at a reduced rate. Points are then
+ * grouped into buckets of 1 / rate seconds, and only the minimum, maximum and
+ * last point of each bucket are sent, so short spikes still show up.
  *
  * The time value in each data pair is handled internally.
  *
  * Use the function hasIntervalPassed() to limit the frequency of data sending
  * in looping situations.
  *
+ * Data points are buffered per client and sent together when
+ * ResetInterval() or Flush() is called, so each interval costs one wakeup of
+ * the socket thread and one sendmsg(2) per client.
+ *
+ * GraphData() hands points to the socket thread through a lock-free queue and
+ * never waits on network I/O. If the queue is full, the point is dropped and
+ * counted instead. GraphData(), Flush() and the interval functions must all be
+ * called from the same thread.
+ *
+ * The "socket thread" below is the NetReactor thread shared with the robot's
+ * other network endpoints.
+ *
+ * Instead of calling GraphData() from a loop, values can be registered as
+ * probes with AddProbe(). StartSampling() then reads every probe at a fixed
+ * rate on a separate thread, so the sample timing doesn't depend on the
+ * caller's loop and the loop does no graphing work.
+ *
+ * To catch short events without streaming everything at a high rate, use
+ * AddCapture(). The host keeps a window of recent points for the dataset, and
+ * when a threshold crossing or Trigger() fires, sends the points from before
+ * and after the trigger under a separate "(capture)" dataset.
+ *
+ * For long tests, AddStatistics() publishes a dataset's mean, standard
+ * deviation, minimum, maximum and 99th percentile once per window instead of
+ * every point, so drift stays visible at a fraction of the bandwidth.
+ *
+ * StartRecording() additionally saves every point to disk, whether or not any
+ * client is subscribed to it. See GraphRecorder for the file format.
+ *
+ * StartSharedMemory() publishes every point into a shared memory ring, so
+ * other processes on the robot can read the data with GraphRingReader without
+ * any system calls.
+ *
+ * EnableTelemetry() publishes the host's own health as datasets whose names
+ * start with "LG", so a lagging graph can be traced to the robot code, the
+ * socket thread or the network. Version 2 clients can also ask for the same
+ * counters with k_hostStatsPacket.
+ *
  * Example:
  *     GraphHost pidGraph(3513);
  *     pidGraph.SetSendInterval(5ms);
+ *     auto rpmData = pidGraph.RegisterDataset("PID0");
  *
  *     if (pidGraph.HasIntervalPassed()) {
- *         pidGraph.GraphData(frisbeeShooter.getRPM(), "PID0");
+ *         pidGraph.GraphData(frisbeeShooter.getRPM(), rpmData);
  *         pidGraph.GraphData(frisbeeShooter.getTargetRPM(), "PID1");
+ *         pidGraph.GraphSnapshot({{setpointData, controller.GetSetpoint()},
+ *                                 {positionData, controller.GetPosition()}});
  *
  *         pidGraph.ResetInterval();
  *     }
@@ -45,14 +105,212 @@
 
 class GraphHost {
 public:
+    // Identifies a dataset registered with RegisterDataset()
+    using DatasetHandle = uint16_t;
+
+    // Maximum number of datasets
+    static constexpr size_t k_maxDatasets = ::k_maxDatasets;
+
+    // Number of clients that get their own telemetry datasets
+    static constexpr size_t k_telemetryClients = 4;
+
+    // Returned by RegisterDataset() when no more datasets can be added
+    static constexpr DatasetHandle k_invalidDataset = 0xFFFF;
+
+    // A value for one dataset in GraphSnapshot()
+    struct SnapshotValue {
+        // Takes a double so brace-initializing from a double isn't narrowing
+        SnapshotValue(DatasetHandle d, double v) : dataset(d), value(v) {}
+
+        DatasetHandle dataset;
+        float value;
+    };
+
+    // Direction of a threshold crossing that fires a capture
+    enum class TriggerEdge { Rising, Falling, Either };
+
+    // Statistics AddStatistics() can publish, combined with bitwise OR
+    enum Statistic {
+        Mean = 1,
+        StdDev = 2,
+        Min = 4,
+        Max = 8,
+        P99 = 16,
+        AllStatistics = 31
+    };
+
+    // Counters for measuring how well output is batched
+    struct Stats {
+        // Data packets queued for clients
+        uint64_t queuedPackets = 0;
+
+        // Times the socket thread was woken to send queued data
+        uint64_t flushes = 0;
+
+        // Calls to sendmsg(2) and the bytes they wrote
+        uint64_t sendCalls = 0;
+        uint64_t sentBytes = 0;
+
+        // Points dropped because the socket thread fell behind
+        uint64_t droppedSamples = 0;
+
+        // Packets dropped because a client's queue was full
+        uint64_t droppedPackets = 0;
+
+        // Longest time a GraphData() call has taken
+        std::chrono::nanoseconds maxPublishTime{0};
+
+        // Longest time the socket thread has spent handling one wakeup
+        std::chrono::nanoseconds maxLoopTime{0};
+
+        // Sampler ticks skipped because reading the probes took too long
+        uint64_t sampleOverruns = 0;
+
+        // Points written to the current recording and points it failed to write
+        uint64_t recordedSamples = 0;
+        uint64_t failedRecordings = 0;
+    };
+
+    // Back-pressure counters for one client
+    struct ClientStats {
+        std::string address;
+
+        // Data waiting to be sent, and the most that has been waiting
+        size_t queuedBytes = 0;
+        size_t queuedPackets = 0;
+        size_t maxQueuedBytes = 0;
+
+        uint64_t sentBytes = 0;
+
+        // Send rate over about the last second
+        uint64_t bytesPerSecond = 0;
+
+        // Packets discarded because the client's queue was full
+        uint64_t droppedPackets = 0;
+        uint64_t droppedBytes = 0;
+
+        // Time from queueing a packet until it was fully sent
+        std::chrono::microseconds averageSendLatency{0};
+        std::chrono::microseconds maxSendLatency{0};
+    };
+
     explicit GraphHost(int port);
     ~GraphHost();
 
+    /* Returns the handle for the named dataset, adding the dataset to the list
+     * sent to clients if it doesn't exist yet. Returns k_invalidDataset if
+     * k_maxDatasets datasets already exist. May be called from any thread.
+     *
+     * 'encoding' selects how version 2 clients receive values. For
+     * k_encodingQuantized16, values are sent as round(value / scale) in a
+     * 16-bit signed integer. The encoding of an existing dataset isn't
+     * changed.
+     */
+    DatasetHandle RegisterDataset(const std::string& name,
+                                  uint8_t encoding = k_encodingFloat32,
+                                  float scale = 1.f);
+
     /* Send data (y value) for a given dataset to remote client. The current
      * time is sent as the x value. Returns true if data was sent successfully
      * and false upon failure or host isn't running.
      */
-    bool GraphData(float value, std::string dataset);
+    bool GraphData(float value, DatasetHandle dataset);
+
+    /* Sends data with the given time in milliseconds since the epoch instead
+     * of the current time. This is used to replay recorded data.
+     */
+    bool GraphData(float value, DatasetHandle dataset, uint64_t time);
+
+    // Registers the dataset by name if needed, then sends the data
+    bool GraphData(float value, const std::string& dataset);
+
+    /* Sends values for several datasets with one timestamp, such as a setpoint
+     * and the measurement it's compared with. Clients receive either all of
+     * the values or none of them. Returns false if they weren't queued.
+     */
+    bool GraphSnapshot(std::initializer_list<SnapshotValue> values);
+
+    /* Registers a value for the sampler thread to graph and returns its
+     * dataset. 'probe' is called from the sampler thread, so it must be safe
+     * to call while other threads update the value. Probes may be added while
+     * sampling.
+     */
+    DatasetHandle AddProbe(const std::string& name,
+                           std::function<float()> probe);
+
+    // Registers an atomic variable for the sampler thread to graph
+    template <class T>
+    DatasetHandle AddProbe(const std::string& name,
+                           const std::atomic<T>* value);
+
+    /* Starts a thread that reads every probe once per 'period'. Deadlines are
+     * absolute, so sampling doesn't drift, and all probes read in one tick
+     * share a timestamp. Points are sent every send interval as set when
+     * this is called. Restarts the thread if it's already running.
+     */
+    template <typename Rep, typename Period>
+    void StartSampling(const std::chrono::duration<Rep, Period>& period);
+
+    // Stops the sampler thread
+    void StopSampling();
+
+    /* Keeps the points of 'dataset' from the last 'preTrigger' of time. When
+     * the capture is triggered, those points and the ones that follow for
+     * 'postTrigger' are sent under a dataset named after 'dataset' with
+     * " (capture)" appended, which is returned. Clients and recordings see
+     * the capture dataset like any other. Adding a capture for a dataset that
+     * already has one replaces it, and its threshold must be set again.
+     * Returns k_invalidDataset on failure.
+     */
+    DatasetHandle AddCapture(DatasetHandle dataset,
+                             std::chrono::milliseconds preTrigger,
+                             std::chrono::milliseconds postTrigger);
+
+    /* Triggers the capture of 'dataset' when its value crosses 'threshold' in
+     * the direction given by 'edge'
+     */
+    void SetTriggerThreshold(DatasetHandle dataset, float threshold,
+                             TriggerEdge edge = TriggerEdge::Rising);
+
+    /* Triggers every capture that isn't already in progress, such as when a
+     * state machine enters a state worth looking at
+     */
+    void Trigger();
+
+    /* Publishes the selected statistics of 'dataset' over consecutive windows
+     * of 'window', aligned to multiples of it since the epoch. Each statistic
+     * is a dataset named after 'dataset' with " (mean)", " (stddev)",
+     * " (min)", " (max)" or " (p99)" appended, and gets one point per window
+     * that had any points, timestamped at the window's end. The standard
+     * deviation is the population one, and the 99th percentile uses the
+     * nearest rank. Calling this again for the same dataset replaces its
+     * window and selection. Returns false if a dataset couldn't be
+     * registered.
+     */
+    bool AddStatistics(DatasetHandle dataset, std::chrono::milliseconds window,
+                       int statistics = AllStatistics);
+
+    /* Publishes the host's health every 'period' as these datasets:
+     *
+     * "LG loop time (us)": longest socket thread wakeup in the period
+     * "LG publish time (us)": longest GraphData() call in the period
+     * "LG dropped points": points dropped in the period by a full queue
+     * "LG clients": number of connected clients
+     *
+     * and for each of the first k_telemetryClients clients, numbered in order
+     * of connection:
+     *
+     * "LG client N B/s": send rate
+     * "LG client N queue (B)": bytes waiting to be sent
+     * "LG client N drops": packets dropped in the period by a full queue
+     *
+     * A period of zero stops publishing. Must be called from the thread that
+     * calls GraphData().
+     */
+    void EnableTelemetry(std::chrono::milliseconds period);
+
+    // Returns true while the socket thread is accepting clients
+    bool IsRunning() const;
 
     /* Sets time interval after which data is sent to graph (milliseconds per
      * sample)
@@ -70,6 +328,52 @@ public:
      */
     void ResetInterval();
 
+    /* Wakes the socket thread to send data queued by GraphData() since the
+     * last flush. ResetInterval() calls this.
+     */
+    void Flush();
+
+    /* Returns counters summed over current and past connections. May be called
+     * from any thread.
+     */
+    Stats GetStats() const;
+
+    /* Limits how much data may wait to be sent to each client. When a client
+     * falls behind far enough to exceed either limit, 'policy' selects whether
+     * its oldest or newest data is dropped or it is disconnected. May be
+     * called from any thread.
+     */
+    void SetQueueLimits(size_t maxBytes, size_t maxPackets,
+                        SocketConnection::OverflowPolicy policy);
+
+    /* Returns back-pressure counters for each connected client. May be called
+     * from any thread.
+     */
+    std::vector<ClientStats> GetClientStats() const;
+
+    /* Records every point to memory-mapped files in 'directory', which must
+     * exist. Each file is preallocated to 'fileSize' bytes, and the oldest
+     * file is deleted when more than 'maxFiles' exist, which is at least two.
+     * Replaces any recording in progress. Returns false if the first file
+     * couldn't be created.
+     */
+    bool StartRecording(const std::string& directory,
+                        size_t fileSize = 8 * 1024 * 1024,
+                        size_t maxFiles = 8);
+
+    // Stops recording and closes the current file
+    void StopRecording();
+
+    /* Publishes every point into the POSIX shared memory object 'name', such
+     * as "/livegrapher", which holds the last 'capacity' points. See
+     * common/GraphRing.hpp for the layout. Replaces any ring already being
+     * published. Returns false if the object couldn't be created.
+     */
+    bool StartSharedMemory(const std::string& name, size_t capacity = 4096);
+
+    // Stops publishing and removes the shared memory object
+    void StopSharedMemory();
+
 private:
     // Last time data was graphed
     uint64_t m_lastTime = 0;
@@ -82,28 +386,342 @@ private:
     // Used as a temp variable in graphData()
     uint64_t m_currentTime;
 
-    // Mark the thread as not running, this will be set to true by the thread
+    // A data point on its way from GraphData() to the socket thread
+    struct Sample {
+        DatasetHandle dataset;
+        uint64_t time;
+        float value;
+    };
+
+    // Set to true once the host accepts clients
     std::atomic<bool> m_running{false};
-    std::thread m_thread;
-    std::mutex m_mutex;
-    int m_ipcfd_r;
-    int m_ipcfd_w;
+
+    // Listening socket, watched by NetReactor
+    int m_listenfd = -1;
+
+    /* Wakes the socket thread. Both refer to the same eventfd, or are -1 if it
+     * couldn't be created.
+     */
+    int m_ipcfd_r = -1;
+    int m_ipcfd_w = -1;
     int m_port;
-    std::map<std::string, uint8_t> m_graphList;
+
+    struct Dataset {
+        std::string name;
+        uint8_t encoding;
+        float scale;
+    };
+
+    // Datasets version 1 clients can address with six-bit IDs
+    static constexpr size_t k_maxDatasetsV1 = 64;
+
+    // Most sample bytes in one version 2 frame
+    static constexpr size_t k_maxFrameLength = 1024;
+
+    /* Registered datasets indexed by handle. Entries below m_datasetCount are
+     * never modified again, so the socket thread reads them without locking.
+     */
+    std::array<Dataset, k_maxDatasets> m_datasets;
+    std::atomic<size_t> m_datasetCount{0};
+
+    // Finds existing handles by name; guarded by m_registerMutex
+    std::map<std::string, DatasetHandle> m_graphList;
+    std::mutex m_registerMutex;
+
+    // Points published by GraphData() and consumed by the socket thread
+    SpscQueue<Sample, 4096> m_samples;
+
+    // A value read by the sampler thread
+    struct Probe {
+        DatasetHandle dataset;
+        std::function<float()> read;
+    };
+
+    // Guarded by m_probeMutex
+    std::vector<Probe> m_probes;
+    std::mutex m_probeMutex;
+
+    std::thread m_samplerThread;
+
+    // Set to tell the sampler thread to exit; guarded by m_samplerMutex
+    bool m_stopSampling = false;
+    std::mutex m_samplerMutex;
+    std::condition_variable m_samplerCond;
+
+    // Points read by the sampler thread and consumed by the socket thread
+    SpscQueue<Sample, 4096> m_probeSamples;
+
+    std::atomic<uint64_t> m_sampleOverruns{0};
+
+    // Triggered capture of one dataset, only used by the socket thread
+    struct Capture {
+        DatasetHandle source;
+        DatasetHandle output;
+        uint64_t preTrigger;
+        uint64_t postTrigger;
+
+        bool hasThreshold = false;
+        float threshold = 0.f;
+        TriggerEdge edge = TriggerEdge::Rising;
+
+        /* Ring of the points from the last preTrigger milliseconds. It's
+         * sized when the capture is added so collecting doesn't allocate.
+         */
+        std::vector<SocketConnection::Point> history;
+        size_t historyStart = 0;
+        size_t historySize = 0;
+
+        // Returns the 'i'th oldest point in the ring
+        SocketConnection::Point& HistoryAt(size_t i) {
+            return history[(historyStart + i) % history.size()];
+        }
+
+        // Set while points after the trigger are being sent
+        bool triggered = false;
+        uint64_t endTime = 0;
+    };
+
+    // Guarded by m_captureMutex
+    std::vector<Capture> m_captures;
+    std::mutex m_captureMutex;
+
+    // Statistics of one dataset, only used by the socket thread
+    struct WindowStatistics {
+        DatasetHandle source;
+        uint64_t window;
+
+        // Output datasets, or k_invalidDataset if not selected
+        DatasetHandle meanDataset = k_invalidDataset;
+        DatasetHandle stdDevDataset = k_invalidDataset;
+        DatasetHandle minDataset = k_invalidDataset;
+        DatasetHandle maxDataset = k_invalidDataset;
+        DatasetHandle p99Dataset = k_invalidDataset;
+
+        // Start of the current window, or zero if no point is in it yet
+        uint64_t start = 0;
+
+        // Running mean and sum of squared deviations (Welford's method)
+        uint64_t count = 0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        float minValue = 0.f;
+        float maxValue = 0.f;
+
+        // The window's points, kept only for the percentile
+        std::vector<float> values;
+    };
+
+    // Guarded by m_statisticsMutex
+    std::vector<WindowStatistics> m_statistics;
+    std::mutex m_statisticsMutex;
+
+    /* The newest sample time minus the system clock when it was dispatched.
+     * Buckets and statistics windows start at sample times, so they close on
+     * the samples' clock, which lags the system clock when recorded data is
+     * replayed. Only used by the socket thread.
+     */
+    int64_t m_sampleClockOffset = 0;
+
+    // Time of the last Trigger() call, or zero once the socket thread saw it
+    std::atomic<uint64_t> m_triggerTime{0};
+
+    // Reused by GraphSnapshot() so it only allocates when it grows
+    std::vector<Sample> m_snapshot;
+
+    // True if GraphData() queued points since the last Flush()
+    bool m_flushPending = false;
+
+    // Only accessed by the socket thread
     std::vector<std::unique_ptr<SocketConnection>> m_connList;
 
-    // Temporary buffer used in ReadPackets()
-    std::string m_buf;
+    // Counters from closed connections, only accessed by the socket thread
+    Stats m_closedStats;
+
+    // Counters published for GetStats()
+    std::atomic<uint64_t> m_queuedPackets{0};
+    std::atomic<uint64_t> m_flushes{0};
+    std::atomic<uint64_t> m_sendCalls{0};
+    std::atomic<uint64_t> m_sentBytes{0};
+    std::atomic<uint64_t> m_droppedSamples{0};
+    std::atomic<uint64_t> m_droppedPackets{0};
+    std::atomic<int64_t> m_maxPublishTime{0};
+
+    // Per-client counters published for GetClientStats()
+    std::vector<ClientStats> m_clientStats;
+    mutable std::mutex m_clientStatsMutex;
+
+    // Queue limits applied to every client
+    std::atomic<size_t> m_maxQueueBytes{256 * 1024};
+    std::atomic<size_t> m_maxQueuePackets{4096};
+    std::atomic<SocketConnection::OverflowPolicy> m_overflowPolicy{
+        SocketConnection::DropOldest};
+
+    /* Recording of every point, written by the socket thread. The control
+     * thread only takes the mutex to start or stop recording.
+     */
+    std::unique_ptr<GraphRecorder> m_recorder;
+    std::mutex m_recorderMutex;
+
+    /* Shared memory ring written by the socket thread. The control thread only
+     * takes the mutex to start or stop publishing.
+     */
+    std::unique_ptr<GraphRingWriter> m_ring;
+    std::mutex m_ringMutex;
+
+    // Recording counters published for GetStats()
+    std::atomic<uint64_t> m_recordedSamples{0};
+    std::atomic<uint64_t> m_failedRecordings{0};
+
+    // Datasets published by EnableTelemetry()
+    struct TelemetryDatasets {
+        DatasetHandle loopTime;
+        DatasetHandle publishTime;
+        DatasetHandle droppedSamples;
+        DatasetHandle clients;
+        std::array<DatasetHandle, k_telemetryClients> clientRate;
+        std::array<DatasetHandle, k_telemetryClients> clientQueue;
+        std::array<DatasetHandle, k_telemetryClients> clientDrops;
+    };
+
+    /* Filled in once, before m_telemetryPeriod first becomes nonzero; only
+     * accessed by the control thread until then
+     */
+    TelemetryDatasets m_telemetry;
+    bool m_telemetryRegistered = false;
+
+    // Milliseconds between telemetry points, or zero if disabled
+    std::atomic<uint32_t> m_telemetryPeriod{0};
+
+    // Wakes the socket thread when telemetry is due
+    int m_telemetryfd = -1;
+
+    // Telemetry state only accessed by the socket thread
+    uint64_t m_nextTelemetry = 0;
+    uint64_t m_telemetryDroppedSamples = 0;
+    std::chrono::steady_clock::duration m_periodLoopTime{0};
+
+    // Longest socket thread wakeup, published for GetStats()
+    std::atomic<int64_t> m_maxLoopTime{0};
+
+    // Longest GraphData() call since telemetry was last published
+    std::atomic<int64_t> m_periodPublishTime{0};
+
+    /* Encoded dataset list replies, extended by the socket thread when
+     * datasets are registered instead of being rebuilt for each request
+     */
+    std::string m_listV1;
+    std::string m_listV2;
+
+    // Number of datasets in the lists
+    size_t m_listCount = 0;
 
     static inline uint8_t packetID(uint8_t id);
     static inline uint8_t graphID(uint8_t id);
 
-    void socket_threadmain();
+    // Returns the size of the host packet starting with 'id', or 0 if unknown
+    static size_t hostPacketLength(uint8_t id);
+
+    // Starts the sampler thread with a period in nanoseconds
+    void StartSamplerThread(std::chrono::nanoseconds period);
+
+    void sampler_threadmain(std::chrono::nanoseconds period,
+                            std::chrono::milliseconds sendInterval);
+
+    // NetReactor handlers for the listener, the eventfd and each client
+    void OnAccept();
+
+    // Handles the eventfd or telemetry timer 'fd' by reading its counter
+    void OnWake(int fd);
+    void OnConnectionEvent(SocketConnection* conn, uint32_t events);
+
+    /* Queues new points, sends queued data, and closes clients that failed or
+     * fell too far behind
+     */
+    void Service();
+
+    // Accepts a client and adds it to m_connList. Returns null on failure.
+    SocketConnection* AcceptConnection(int listenfd);
+
+    // Folds a closing connection's counters into the totals
+    void CloseConnection(SocketConnection* conn);
+
+    // Wakes the socket thread
+    void Wake();
 
     static int socket_listen(int port, uint32_t s_addr);
     static int socket_accept(int listenfd);
 
+    /* Handles packets from the client. Returns 1 if data was read, 0 if no data
+     * was available, or -1 if the connection should be closed.
+     */
     int ReadPackets(SocketConnection* conn);
+
+    // Queues the dataset list in the client's protocol version
+    void SendDatasetList(SocketConnection* conn);
+
+    // Appends datasets registered since the last call to the encoded lists
+    void UpdateDatasetLists();
+
+    // Queues a reply to k_hostStatsPacket
+    void SendStats(SocketConnection* conn);
+
+    /* Queues points received from GraphData() and the sampler thread for
+     * subscribed clients and records them
+     */
+    void DispatchSamples();
+
+    // Queues one point for subscribed clients and records it
+    void DispatchSample(const Sample& sample);
+
+    // Feeds a point to the captures of its dataset
+    void CapturePoint(const Sample& sample);
+
+    // Sends a capture's history and starts sending the points after 'time'
+    void FireCapture(Capture& capture, uint64_t time);
+
+    // Adds a point to the statistics of its dataset
+    void AccumulateStatistics(const Sample& sample);
+
+    // Publishes a window's statistics and starts the next window
+    void EmitStatistics(WindowStatistics& statistics);
+
+    // Writes a point to the recording, naming any new datasets first
+    void RecordSample(const Sample& sample);
+
+    // Writes a point to the shared memory ring, naming any new datasets first
+    void PublishToRing(const Sample& sample);
+
+    // Dispatches the telemetry points for the period ending at 'time'
+    void PublishTelemetry(uint64_t time);
+
+    // Updates the publish time maximums with a call that began at 'start'
+    void NotePublishTime(std::chrono::steady_clock::time_point start);
+
+    // Updates the loop time maximums with one socket thread wakeup
+    void NoteLoopTime(std::chrono::steady_clock::duration elapsed);
+
+    /* Encodes a value in the dataset's version 2 encoding into 'buf' and
+     * returns its length
+     */
+    size_t EncodeValue(char* buf, DatasetHandle dataset, float value);
+
+    // Appends a sample with an encoded value to the client's version 2 frame
+    void AppendToFrame(SocketConnection* conn, DatasetHandle dataset,
+                       uint64_t time, const char* value, size_t length);
+
+    // Adds a point to the client's bucket for the dataset
+    void AddToBucket(SocketConnection* conn, DatasetHandle dataset,
+                     const SocketConnection::Point& point);
+
+    // Sends the points kept by a bucket and empties it
+    void EmitBucket(SocketConnection* conn, DatasetHandle dataset,
+                    SocketConnection::Bucket& bucket);
+
+    // Queues the client's current version 2 frame for writing
+    static void FinishFrame(SocketConnection* conn);
+
+    // Publishes connection counters for GetStats()
+    void UpdateStats();
 };
 
 #include "GraphHost.inl"
@@ -10,3 +10,18 @@ void GraphHost::SetSendInterval(
 
     m_sendInterval = duration_cast<milliseconds>(time).count();
 }
+
+template <class T>
+GraphHost::DatasetHandle GraphHost::AddProbe(const std::string& name,
+                                             const std::atomic<T>* value) {
+    return AddProbe(name, [value] {
+        return static_cast<float>(value->load(std::memory_order_relaxed));
+    });
+}
+
+template <typename Rep, typename Period>
+void GraphHost::StartSampling(
+    const std::chrono::duration<Rep, Period>& period) {
+    StartSamplerThread(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(period));
+}
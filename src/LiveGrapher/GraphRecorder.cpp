@@ -0,0 +1,316 @@
+// Copyright (c) 2013-2017 FRC Team 3512. All Rights Reserved.
+
+#include "GraphRecorder.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+constexpr uint8_t GraphRecorder::k_recordEnd;
+constexpr uint8_t GraphRecorder::k_recordDataset;
+constexpr uint8_t GraphRecorder::k_recordSample;
+constexpr size_t GraphRecorder::k_headerSize;
+constexpr size_t GraphRecorder::k_sampleRecordSize;
+
+// Writes 'value' to 'buf' in network byte order and returns the next byte
+template <class T>
+static char* Put(char* buf, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        buf[i] = value >> (8 * (sizeof(T) - 1 - i));
+    }
+    return buf + sizeof(T);
+}
+
+GraphRecorder::GraphRecorder(const std::string& directory, size_t fileSize,
+                             size_t maxFiles)
+    : m_directory(directory),
+      m_fileSize(fileSize),
+      m_maxFiles(std::max<size_t>(maxFiles, 2)) {
+    ScanDirectory();
+
+    // The first file is prepared here so IsOpen() reports whether it worked
+    if (PrepareFile(m_next)) {
+        OpenFile();
+    }
+
+    m_thread = std::thread([this] { threadmain(); });
+}
+
+GraphRecorder::~GraphRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    CloseFile();
+    for (auto& file : m_closing) {
+        FinishFile(file);
+    }
+
+    // Nothing was recorded into the file prepared ahead
+    if (m_next.map != nullptr) {
+        FinishFile(m_next);
+        unlink(FilePath(m_files.back()).c_str());
+    }
+}
+
+bool GraphRecorder::IsOpen() const { return m_map != nullptr; }
+
+void GraphRecorder::AddDataset(const std::string& name) {
+    m_names.emplace_back(name);
+
+    if (IsOpen() && !WriteDataset(m_names.size() - 1)) {
+        // The name doesn't fit, so start a file that lists it up front
+        CloseFile();
+        OpenFile();
+    }
+}
+
+size_t GraphRecorder::DatasetCount() const { return m_names.size(); }
+
+void GraphRecorder::Record(uint16_t dataset, uint64_t time, float value) {
+    // Also retries a file the helper thread couldn't prepare earlier
+    char* buf = IsOpen() ? Reserve(k_sampleRecordSize) : nullptr;
+    if (buf == nullptr) {
+        CloseFile();
+        if (!OpenFile() || (buf = Reserve(k_sampleRecordSize)) == nullptr) {
+            m_failedSamples++;
+            return;
+        }
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    buf = Put<uint8_t>(buf, k_recordSample);
+    buf = Put(buf, dataset);
+    buf = Put(buf, time);
+    Put(buf, bits);
+
+    m_recordedSamples++;
+}
+
+uint64_t GraphRecorder::RecordedSamples() const { return m_recordedSamples; }
+
+uint64_t GraphRecorder::FailedSamples() const { return m_failedSamples; }
+
+void GraphRecorder::threadmain() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_cond.wait(lock, [&] {
+            return m_stop || !m_closing.empty() || m_next.map == nullptr;
+        });
+        if (m_stop) {
+            break;
+        }
+
+        // The flash is only touched with the lock released
+        std::vector<File> closing;
+        closing.swap(m_closing);
+        bool prepare = m_next.map == nullptr;
+        lock.unlock();
+
+        for (auto& file : closing) {
+            FinishFile(file);
+        }
+
+        File next;
+        bool prepared = prepare && PrepareFile(next);
+
+        lock.lock();
+        if (prepared) {
+            m_next = next;
+        } else if (prepare) {
+            // Don't retry in a tight loop if the flash is full
+            m_cond.wait_for(lock, std::chrono::seconds(1),
+                            [&] { return m_stop; });
+        }
+    }
+}
+
+std::string GraphRecorder::FilePath(uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/graph%06u.lg", number);
+    return m_directory + name;
+}
+
+void GraphRecorder::ScanDirectory() {
+    DIR* dir = opendir(m_directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    std::vector<uint32_t> files;
+    while (dirent* entry = readdir(dir)) {
+        // Only accept names FilePath() would have made
+        uint32_t number;
+        if (std::sscanf(entry->d_name, "graph%u", &number) == 1 &&
+            FilePath(number) == m_directory + "/" + entry->d_name) {
+            files.emplace_back(number);
+        }
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end());
+    m_files.assign(files.begin(), files.end());
+}
+
+bool GraphRecorder::PrepareFile(File& file) {
+    uint32_t number = m_files.empty() ? 0 : m_files.back() + 1;
+
+    // Make room for the new file first, so the limit holds even briefly
+    m_files.emplace_back(number);
+    RemoveOldFiles();
+
+    std::string path = FilePath(number);
+    file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file.fd == -1) {
+        std::perror("GraphRecorder: open");
+        m_files.pop_back();
+        return false;
+    }
+
+    /* Reserve every block now. Writing through the mapping into a sparse file
+     * would raise SIGBUS if the flash filled up.
+     */
+    int error = posix_fallocate(file.fd, 0, m_fileSize);
+    if (error == 0) {
+        void* map = mmap(nullptr, m_fileSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, file.fd, 0);
+        if (map != MAP_FAILED) {
+            file.map = static_cast<char*>(map);
+        }
+    }
+
+    if (file.map == nullptr) {
+        std::fprintf(stderr, "GraphRecorder: couldn't map %s\n", path.c_str());
+        close(file.fd);
+        file.fd = -1;
+        unlink(path.c_str());
+        m_files.pop_back();
+        return false;
+    }
+
+    return true;
+}
+
+bool GraphRecorder::OpenFile() {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::system_clock;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next.map == nullptr) {
+            return false;
+        }
+
+        m_fd = m_next.fd;
+        m_map = m_next.map;
+        m_next = File();
+    }
+
+    // Start preparing the file after this one
+    m_cond.notify_one();
+
+    m_length = 0;
+
+    uint64_t now =
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count();
+    char* buf = Reserve(k_headerSize);
+    if (buf == nullptr) {
+        CloseFile();
+        return false;
+    }
+    std::memcpy(buf, "LGR1", 4);
+    Put(buf + 4, now);
+
+    // Name every dataset so the file can be read on its own
+    for (size_t i = 0; i < m_names.size(); i++) {
+        if (!WriteDataset(i)) {
+            CloseFile();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GraphRecorder::CloseFile() {
+    if (m_map == nullptr) {
+        return;
+    }
+
+    m_map[m_length] = k_recordEnd;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        File file;
+        file.fd = m_fd;
+        file.map = m_map;
+        file.length = m_length;
+        m_closing.emplace_back(file);
+    }
+    m_cond.notify_one();
+
+    m_map = nullptr;
+    m_fd = -1;
+}
+
+void GraphRecorder::FinishFile(File& file) const {
+    munmap(file.map, m_fileSize);
+    file.map = nullptr;
+
+    // Give back the space that wasn't used
+    if (ftruncate(file.fd, file.length + 1) == -1) {
+        std::perror("GraphRecorder: ftruncate");
+    }
+    close(file.fd);
+    file.fd = -1;
+}
+
+void GraphRecorder::RemoveOldFiles() {
+    while (m_files.size() > m_maxFiles) {
+        unlink(FilePath(m_files.front()).c_str());
+        m_files.pop_front();
+    }
+}
+
+bool GraphRecorder::WriteDataset(uint16_t dataset) {
+    const std::string& name = m_names[dataset];
+    size_t length = std::min<size_t>(name.length(), 255);
+
+    char* buf = Reserve(4 + length);
+    if (buf == nullptr) {
+        return false;
+    }
+
+    buf = Put<uint8_t>(buf, k_recordDataset);
+    buf = Put(buf, dataset);
+    buf = Put<uint8_t>(buf, length);
+    std::memcpy(buf, name.c_str(), length);
+
+    return true;
+}
+
+char* GraphRecorder::Reserve(size_t length) {
+    if (m_length + length + 1 > m_fileSize) {
+        return nullptr;
+    }
+
+    char* buf = &m_map[m_length];
+    m_length += length;
+    return buf;
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2013-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Records graph data to memory-mapped files so it can be reviewed after a match
+ * even if no client was connected.
+ *
+ * Each file is preallocated to a fixed size and mapped into memory, so
+ * recording a point is a copy into the page cache and never blocks on the
+ * flash. A helper thread preallocates the next file while the current one
+ * fills, and trims and deletes old files, so switching files doesn't block
+ * either. The oldest file is deleted once more than the maximum number exist,
+ * counting the one prepared ahead. Recordings therefore never use more than
+ * fileSize * maxFiles bytes, and at least two files are kept.
+ *
+ * Files are named graph000000.lg, graph000001.lg, etc. Numbering continues from
+ * the files already in the directory and grows past six digits instead of
+ * wrapping, so the lowest number is always the oldest. Each file starts with
+ * a header and the name of every dataset known so far, followed by records in
+ * the order they were made. All fields are in network byte order.
+ *
+ * Header:
+ *     char magic[4]        "LGR1"
+ *     uint64_t startTime   milliseconds since the epoch
+ *
+ * Dataset record (names the dataset for the rest of the file):
+ *     uint8_t type         k_recordDataset
+ *     uint16_t dataset
+ *     uint8_t length
+ *     char name[length]
+ *
+ * Sample record:
+ *     uint8_t type         k_recordSample
+ *     uint16_t dataset
+ *     uint64_t time        milliseconds since the epoch
+ *     float value
+ *
+ * A type of zero marks the end of the data. A file that wasn't closed cleanly
+ * keeps its preallocated length, and the zero-filled remainder ends it.
+ *
+ * Apart from its helper thread, GraphRecorder isn't thread-safe. GraphHost
+ * only uses it from its socket thread.
+ */
+class GraphRecorder {
+public:
+    static constexpr uint8_t k_recordEnd = 0;
+    static constexpr uint8_t k_recordDataset = 1;
+    static constexpr uint8_t k_recordSample = 2;
+
+    static constexpr size_t k_headerSize = 12;
+    static constexpr size_t k_sampleRecordSize = 15;
+
+    /* Creates the first file in 'directory'. IsOpen() returns false if it
+     * couldn't be created.
+     */
+    GraphRecorder(const std::string& directory, size_t fileSize,
+                  size_t maxFiles);
+    ~GraphRecorder();
+    GraphRecorder(const GraphRecorder&) = delete;
+    GraphRecorder& operator=(const GraphRecorder&) = delete;
+
+    // Returns true while points are being recorded
+    bool IsOpen() const;
+
+    /* Names the next dataset. Datasets must be added in handle order, starting
+     * from zero.
+     */
+    void AddDataset(const std::string& name);
+
+    // Returns the number of datasets added
+    size_t DatasetCount() const;
+
+    // Appends a point, starting a new file first if the current one is full
+    void Record(uint16_t dataset, uint64_t time, float value);
+
+    // Returns the number of points recorded and the number lost to I/O errors
+    uint64_t RecordedSamples() const;
+    uint64_t FailedSamples() const;
+
+private:
+    // A preallocated file mapped into memory
+    struct File {
+        int fd = -1;
+        char* map = nullptr;
+
+        // Bytes that have been written
+        size_t length = 0;
+    };
+
+    std::string m_directory;
+    size_t m_fileSize;
+    size_t m_maxFiles;
+
+    // Dataset names indexed by handle
+    std::vector<std::string> m_names;
+
+    // Numbers of the recordings in the directory, oldest first
+    std::deque<uint32_t> m_files;
+
+    int m_fd = -1;
+    char* m_map = nullptr;
+
+    // Bytes of the current file that have been written
+    size_t m_length = 0;
+
+    uint64_t m_recordedSamples = 0;
+    uint64_t m_failedSamples = 0;
+
+    std::thread m_thread;
+
+    // Guards the fields below, which are shared with the helper thread
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+
+    // The file to switch to when the current one fills up
+    File m_next;
+
+    // Files the recording thread is done with, waiting to be trimmed
+    std::vector<File> m_closing;
+
+    void threadmain();
+
+    // Returns the path of the recording with the given number
+    std::string FilePath(uint32_t number) const;
+
+    // Finds the recordings already in the directory
+    void ScanDirectory();
+
+    /* Creates, preallocates and maps the file after the newest one, deleting
+     * old recordings to make room first. Returns false on failure.
+     */
+    bool PrepareFile(File& file);
+
+    /* Switches to the file the helper thread prepared and writes its header
+     * and dataset names. Returns false if there isn't one or on failure.
+     */
+    bool OpenFile();
+
+    /* Ends the current file and hands it to the helper thread to be unmapped
+     * and trimmed to the data written
+     */
+    void CloseFile();
+
+    // Unmaps a file, trims it to the data written and closes it
+    void FinishFile(File& file) const;
+
+    // Deletes the oldest recordings until at most m_maxFiles remain
+    void RemoveOldFiles();
+
+    /* Writes a dataset record to the current file. Returns false if it doesn't
+     * fit.
+     */
+    bool WriteDataset(uint16_t dataset);
+
+    /* Returns space for a record of 'length' bytes in the current file, or
+     * nullptr if it doesn't fit. One byte is always left for the end marker.
+     */
+    char* Reserve(size_t length);
+};
@@ -0,0 +1,111 @@
+// Copyright (c) 2013-2017 FRC Team 3512. All Rights Reserved.
+
+#include "GraphRingWriter.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+GraphRingWriter::GraphRingWriter(const std::string& name, size_t capacity,
+                                 size_t maxDatasets)
+    : m_name(name) {
+    // Round up to a power of two so the slot is a mask of the index
+    uint32_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    // Readers of an earlier ring keep their mapping of the unlinked object
+    shm_unlink(m_name.c_str());
+
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        std::perror("GraphRingWriter: shm_open");
+        return;
+    }
+
+    m_size = GraphRingSize(slots, maxDatasets);
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, m_size) == 0) {
+        map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        std::perror("GraphRingWriter: mmap");
+        shm_unlink(m_name.c_str());
+        return;
+    }
+
+    // ftruncate() zero-filled the object, which is a valid empty ring
+    m_header = new (map) GraphRingHeader;
+    m_header->capacity = slots;
+    m_header->maxDatasets = maxDatasets;
+    m_header->version = k_graphRingVersion;
+    m_datasets = GraphRingDatasets(m_header);
+    m_slots = GraphRingSlots(m_header);
+    m_mask = slots - 1;
+
+    // Readers ignore the ring until the magic number appears
+    m_header->magic.store(k_graphRingMagic, std::memory_order_release);
+}
+
+GraphRingWriter::~GraphRingWriter() {
+    if (m_header == nullptr) {
+        return;
+    }
+
+    m_header->closed.store(1, std::memory_order_release);
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+}
+
+bool GraphRingWriter::IsOpen() const { return m_header != nullptr; }
+
+void GraphRingWriter::AddDataset(const std::string& name) {
+    m_addedDatasets++;
+
+    if (!IsOpen() || m_datasetCount == m_header->maxDatasets) {
+        return;
+    }
+
+    // The zero-filled entry already ends in a NUL
+    std::strncpy(m_datasets[m_datasetCount].name, name.c_str(),
+                 k_graphRingNameLength - 1);
+
+    // Fill in the entry before readers can see it
+    m_datasetCount++;
+    m_header->datasetCount.store(m_datasetCount, std::memory_order_release);
+}
+
+size_t GraphRingWriter::DatasetCount() const { return m_addedDatasets; }
+
+void GraphRingWriter::Write(uint16_t dataset, uint64_t time, float value) {
+    if (!IsOpen()) {
+        return;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    GraphRingSlot& slot = m_slots[m_writeIndex & m_mask];
+    uint32_t lap = m_writeIndex / m_header->capacity;
+
+    // An odd sequence tells readers the slot is changing
+    slot.sequence.store(2 * lap + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.dataset.store(dataset, std::memory_order_relaxed);
+    slot.time.store(time, std::memory_order_relaxed);
+    slot.value.store(bits, std::memory_order_relaxed);
+
+    slot.sequence.store(2 * lap + 2, std::memory_order_release);
+
+    m_writeIndex++;
+    m_header->writeIndex.store(m_writeIndex, std::memory_order_release);
+}
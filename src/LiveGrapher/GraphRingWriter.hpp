@@ -0,0 +1,68 @@
+// Copyright (c) 2013-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "../../common/GraphRing.hpp"
+
+/**
+ * Publishes graph data into a POSIX shared memory ring for other processes on
+ * the robot. See common/GraphRing.hpp for the layout.
+ *
+ * Writing a point is a few stores into the ring with no system calls. The
+ * writer never waits for readers; a reader that falls more than a lap behind
+ * loses the points that were overwritten.
+ *
+ * Any object already using the name is unlinked first, so readers of a ring
+ * from an earlier run keep their old mapping and should reopen once they see
+ * it closed. The object is unlinked again when the writer is destroyed.
+ *
+ * GraphRingWriter isn't thread-safe. GraphHost only uses it from its socket
+ * thread.
+ */
+class GraphRingWriter {
+public:
+    /* Creates the shared memory object 'name', such as "/livegrapher", with
+     * room for at least 'capacity' points and 'maxDatasets' dataset names.
+     * IsOpen() returns false if it couldn't be created.
+     */
+    GraphRingWriter(const std::string& name, size_t capacity,
+                    size_t maxDatasets);
+    ~GraphRingWriter();
+    GraphRingWriter(const GraphRingWriter&) = delete;
+    GraphRingWriter& operator=(const GraphRingWriter&) = delete;
+
+    // Returns true while points are being published
+    bool IsOpen() const;
+
+    /* Names the next dataset. Datasets must be added in handle order, starting
+     * from zero. Datasets past maxDatasets are ignored.
+     */
+    void AddDataset(const std::string& name);
+
+    // Returns the number of datasets added
+    size_t DatasetCount() const;
+
+    // Publishes a point, overwriting the oldest one if the ring is full
+    void Write(uint16_t dataset, uint64_t time, float value);
+
+private:
+    std::string m_name;
+    size_t m_size = 0;
+
+    GraphRingHeader* m_header = nullptr;
+    GraphRingDataset* m_datasets = nullptr;
+    GraphRingSlot* m_slots = nullptr;
+
+    // Copies of header fields that only this writer changes
+    uint32_t m_mask = 0;
+    uint32_t m_datasetCount = 0;
+    uint64_t m_writeIndex = 0;
+
+    // Datasets added, including any that didn't fit in the table
+    size_t m_addedDatasets = 0;
+};
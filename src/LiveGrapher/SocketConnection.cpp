@@ -4,29 +4,31 @@
 
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#ifdef __VXWORKS__
-#include <sockLib.h>
-#endif
-
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <utility>
 
 #include "GraphHost.hpp"
 
-SocketConnection::SocketConnection(int nfd, int ipcWriteSock) {
-    fd = nfd;
-    m_ipcfd_w = ipcWriteSock;
-}
+constexpr size_t SocketConnection::k_blockSize;
+constexpr size_t SocketConnection::k_maxIovecs;
+
+SocketConnection::SocketConnection(int nfd) { fd = nfd; }
 
 SocketConnection::~SocketConnection() { close(fd); }
 
 int SocketConnection::recvData(char* buf, size_t length) {
     int error = recv(fd, buf, length, 0);
 
-    if (error == 0 || (error == -1 && errno != EAGAIN)) {
+    if (error == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Nothing more to read for now
+        return 0;
+    }
+
+    if (error <= 0) {
         // recv(3) failed, so return failure so socket is closed
         return -1;
     }
@@ -35,42 +37,206 @@ int SocketConnection::recvData(char* buf, size_t length) {
 }
 
 // Write queued data to a socket when the socket becomes ready
-void SocketConnection::writePackets() {
-    /* While the current buffer isn't done sending or there are more buffers to
-     * send
-     */
-    while (!m_writedone || !m_writequeue.empty()) {
-        // Get another buffer to send
-        if (m_writedone) {
-            m_writebuf = std::move(m_writequeue.front());
-            m_writebufoffset = 0;
-            m_writedone = false;
-            m_writequeue.pop();
+int SocketConnection::writePackets() {
+    while (!m_pending.empty()) {
+        // Gather as many pending blocks as one call accepts
+        iovec iov[k_maxIovecs];
+        size_t count = std::min(m_pending.size(), k_maxIovecs);
+        size_t requested = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t offset = i == 0 ? m_writeoffset : 0;
+            iov[i].iov_base = &m_pending[i]->data[offset];
+            iov[i].iov_len = m_pending[i]->length - offset;
+            requested += iov[i].iov_len;
         }
 
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
         // These descriptors are ready for writing
-        m_writebufoffset +=
-            send(fd, &m_writebuf[0], m_writebuf.length() - m_writebufoffset, 0);
-
-        // Have we finished writing the buffer?
-        if (m_writebufoffset == m_writebuf.length()) {
-            // Reset the write buffer
-            m_writebufoffset = 0;
-            m_writedone = true;
-        } else {
-            // We haven't finished writing, keep selecting
-            return;
+        ssize_t sent = sendmsg(fd, &msg, 0);
+        sendCalls++;
+
+        if (sent == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // We haven't finished writing, keep selecting
+                return 0;
+            }
+
+            return -1;
+        }
+
+        sentBytes += sent;
+        m_queuedBytes -= sent;
+
+        // Retire the blocks that were completely written
+        auto now = std::chrono::steady_clock::now();
+        size_t remaining = sent;
+        while (remaining > 0) {
+            Block* block = m_pending.front();
+            size_t unsent = block->length - m_writeoffset;
+
+            if (remaining < unsent) {
+                m_writeoffset += remaining;
+                break;
+            }
+            remaining -= unsent;
+
+            // Record how long the block's packets waited
+            auto latency = now - block->queued;
+            totalSendLatency += latency * block->packets;
+            maxSendLatency = std::max(maxSendLatency, latency);
+            sentPackets += block->packets;
+            m_queuedCount -= block->packets;
+
+            m_pending.pop_front();
+            m_freeBlocks.push_back(block);
+            m_writeoffset = 0;
+        }
+
+        // A short write means the socket buffer is full
+        if (static_cast<size_t>(sent) < requested) {
+            return 0;
         }
     }
 
     // Stop selecting on write
     selectflags &= ~SocketConnection::Write;
+
+    return 0;
 }
 
-void SocketConnection::queueWrite(const char* buf, size_t length) {
-    m_writequeue.emplace(buf, length);
+bool SocketConnection::queueWrite(const char* buf, size_t length,
+                                  bool droppable) {
+    if (overflowed) {
+        return false;
+    }
+
+    // Only packets that fit in one block can be dropped without a trace
+    if (length > k_blockSize) {
+        droppable = false;
+    }
+
+    // Enforce the queue limits on droppable packets
+    while (droppable && (queuedBytes() + length > maxBytes ||
+                         queuedCount() + 1 > maxPackets)) {
+        if (overflowPolicy == Disconnect) {
+            overflowed = true;
+            return false;
+        }
+
+        /* Free a quarter of the limits at once, so a client that stays behind
+         * doesn't trigger this for every new packet
+         */
+        size_t bytesTarget = maxBytes - maxBytes / 4;
+        size_t countTarget = maxPackets - maxPackets / 4;
+        size_t bytes = queuedBytes() + length > bytesTarget
+                           ? queuedBytes() + length - bytesTarget
+                           : 0;
+        size_t count = queuedCount() + 1 > countTarget
+                           ? queuedCount() + 1 - countTarget
+                           : 0;
+
+        if (overflowPolicy == DropNewest || !dropOldest(bytes, count)) {
+            droppedPackets++;
+            droppedBytes += length;
+            return false;
+        }
+    }
+
+    /* Droppable packets share the last block if it has room. Other packets
+     * start a block of their own and may span several.
+     */
+    Block* block = m_pending.empty() ? nullptr : m_pending.back();
+    if (block == nullptr || !droppable || block->sealed ||
+        block->length + length > k_blockSize) {
+        block = allocBlock(droppable);
+    }
+
+    while (true) {
+        size_t count = std::min(length, k_blockSize - block->length);
+        std::memcpy(&block->data[block->length], buf, count);
+        block->length += count;
+        buf += count;
+        length -= count;
+        m_queuedBytes += count;
+
+        if (length == 0) {
+            break;
+        }
+
+        block->sealed = true;
+        block = allocBlock(droppable);
+    }
+
+    if (!droppable) {
+        block->sealed = true;
+    }
+    block->packets++;
+    m_queuedCount++;
+    queuedPackets++;
+
+    maxQueuedBytes = std::max(maxQueuedBytes, queuedBytes());
 
     // Select on write
     selectflags |= SocketConnection::Write;
-    write(m_ipcfd_w, "r", 1);
+
+    return true;
+}
+
+size_t SocketConnection::queuedBytes() const { return m_queuedBytes; }
+
+size_t SocketConnection::queuedCount() const { return m_queuedCount; }
+
+SocketConnection::Block* SocketConnection::allocBlock(bool droppable) {
+    Block* block;
+    if (m_freeBlocks.empty()) {
+        m_slab.emplace_back(std::make_unique<Block>());
+        block = m_slab.back().get();
+    } else {
+        block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    }
+
+    block->length = 0;
+    block->packets = 0;
+    block->droppable = droppable;
+    block->sealed = false;
+    block->queued = std::chrono::steady_clock::now();
+
+    m_pending.push_back(block);
+    return block;
+}
+
+bool SocketConnection::dropOldest(size_t bytes, size_t count) {
+    // A block that has been partly written must be finished
+    auto first = m_pending.begin();
+    if (first != m_pending.end() && m_writeoffset > 0) {
+        first++;
+    }
+
+    // Find the run of droppable blocks to remove
+    auto last = first;
+    size_t freedBytes = 0;
+    size_t freedCount = 0;
+    while (last != m_pending.end() && (*last)->droppable &&
+           (freedBytes < bytes || freedCount < count)) {
+        freedBytes += (*last)->length;
+        freedCount += (*last)->packets;
+        m_freeBlocks.push_back(*last);
+        last++;
+    }
+
+    if (first == last) {
+        return false;
+    }
+    m_pending.erase(first, last);
+
+    m_queuedBytes -= freedBytes;
+    m_queuedCount -= freedCount;
+    droppedPackets += freedCount;
+    droppedBytes += freedBytes;
+
+    return true;
 }
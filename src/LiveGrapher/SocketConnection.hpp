@@ -4,46 +4,186 @@
 
 #include <stdint.h>
 
-#include <queue>
+#include <bitset>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "../../common/Protocol.hpp"
+
 /**
  * Wrapper around graph client socket descriptors
+ *
+ * Outgoing packets are copied into fixed-size blocks from a per-connection
+ * slab. Blocks are recycled instead of freed, so queueing doesn't allocate once
+ * the slab has grown to the connection's working size. writePackets() hands
+ * every pending block to the kernel with one sendmsg(2) call.
+ *
+ * The queue is bounded by maxBytes and maxPackets. When a packet would exceed
+ * either limit, overflowPolicy decides whether the oldest unsent blocks are
+ * dropped, the new packet is dropped, or the connection is closed. Control
+ * packets such as dataset lists are queued as not droppable; they get blocks
+ * of their own, are never dropped, and are allowed past the limits.
  */
 class SocketConnection {
 public:
     enum selector { Read = 1, Write = 2, Error = 4 };
+    enum OverflowPolicy { DropOldest, DropNewest, Disconnect };
+
+    struct Point {
+        uint64_t time;
+        float value;
+    };
 
-    SocketConnection(int nfd, int ipcWriteSock);
+    // Extremes and last value of one decimation period of a dataset
+    struct Bucket {
+        uint32_t period;
+        uint64_t start = 0;
+        bool empty = true;
+        Point min;
+        Point max;
+        Point last;
+    };
+
+    explicit SocketConnection(int nfd);
     ~SocketConnection();
     SocketConnection(const SocketConnection&) = delete;
     SocketConnection& operator=(const SocketConnection&) = delete;
 
+    /* Returns the number of bytes received, 0 if no data is available, or -1
+     * if the connection was closed or failed.
+     */
     int recvData(char* buf, size_t length);
     int readPackets();
-    void writePackets();
 
+    /* Writes as much of the output buffer as the socket accepts. Returns -1 if
+     * the connection failed and should be closed.
+     */
+    int writePackets();
+
+    /* Queues a packet for writing. Returns false if the packet was dropped or
+     * the connection overflowed.
+     */
     template <class T>
-    void queueWrite(T& buf);
+    bool queueWrite(T& buf, bool droppable = true);
 
-    void queueWrite(const char* buf, size_t length);
+    bool queueWrite(const char* buf, size_t length, bool droppable = true);
+
+    // Bytes and packets waiting to be written
+    size_t queuedBytes() const;
+    size_t queuedCount() const;
 
     int fd;
     uint8_t selectflags = Read | Error;
-    std::vector<uint8_t> dataSets;
+
+    // The client's IP address and port
+    std::string address;
+
+    // Bit N is set while the client is subscribed to dataset N
+    std::bitset<k_maxDatasets> dataSets;
+
+    // Protocol version negotiated with the client
+    uint8_t version = 1;
+
+    // Bit N is set if dataset N is sent decimated into buckets
+    std::bitset<k_maxDatasets> decimated;
+    std::unordered_map<uint16_t, Bucket> buckets;
+
+    // Version 2 frame being filled in by the socket thread
+    std::string frame;
+    uint64_t frameBaseTime = 0;
+
+    // Partial host packets waiting for the rest of their bytes
+    char recvbuf[64];
+    size_t recvlen = 0;
+
+    // Limits on data waiting to be written
+    size_t maxBytes = 256 * 1024;
+    size_t maxPackets = 4096;
+    OverflowPolicy overflowPolicy = DropOldest;
+
+    // Set when the Disconnect policy was triggered
+    bool overflowed = false;
+
+    // Number of packets queued and bytes handed to sendmsg(2) so far
+    uint64_t queuedPackets = 0;
+    uint64_t sendCalls = 0;
+    uint64_t sentBytes = 0;
+
+    // Packets that were fully written and their total time spent queued
+    uint64_t sentPackets = 0;
+    std::chrono::steady_clock::duration totalSendLatency{0};
+    std::chrono::steady_clock::duration maxSendLatency{0};
+
+    // Packets and bytes discarded by the overflow policy
+    uint64_t droppedPackets = 0;
+    uint64_t droppedBytes = 0;
+
+    // Largest amount of data that has been waiting to be written
+    size_t maxQueuedBytes = 0;
+
+    // Send rate over about the last second, and where it's measured from
+    uint64_t bytesPerSecond = 0;
+    uint64_t rateSentBytes = 0;
+    std::chrono::steady_clock::time_point rateStart =
+        std::chrono::steady_clock::now();
+
+    // Index of the client's telemetry datasets, or -1 if there are none free
+    int telemetrySlot = -1;
+
+    // Value of droppedPackets when telemetry was last published
+    uint64_t telemetryDroppedPackets = 0;
 
 private:
-    int m_ipcfd_w;
+    // Size of a slab block; larger than any droppable packet
+    static constexpr size_t k_blockSize = 2048;
+
+    // Most blocks passed to one sendmsg(2) call
+    static constexpr size_t k_maxIovecs = 64;
+
+    struct Block {
+        char data[k_blockSize];
+        size_t length;
+
+        // Packets that end in this block
+        size_t packets;
+
+        bool droppable;
+
+        // Set if no more packets may be appended
+        bool sealed;
+
+        // When the block's first packet was queued
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    // Every block allocated for this connection
+    std::vector<std::unique_ptr<Block>> m_slab;
+
+    // Blocks that are ready for reuse
+    std::vector<Block*> m_freeBlocks;
+
+    // Blocks waiting to be written, oldest first
+    std::deque<Block*> m_pending;
+
+    // How much of the first pending block has been written so far
+    size_t m_writeoffset = 0;
 
-    // The buffer that needs to be written into the socket
-    std::string m_writebuf;
+    // Unwritten bytes and packets in m_pending
+    size_t m_queuedBytes = 0;
+    size_t m_queuedCount = 0;
 
-    // How much has been written so far
-    size_t m_writebufoffset = 0;
+    // Returns an empty block from the free list or a new one
+    Block* allocBlock(bool droppable);
 
-    bool m_writedone = true;
-    std::queue<std::string> m_writequeue;
+    /* Removes the oldest droppable blocks that aren't being written until at
+     * least 'bytes' bytes and 'count' packets are freed or a block that can't
+     * be dropped is reached. Returns false if nothing was removed.
+     */
+    bool dropOldest(size_t bytes, size_t count);
 };
 
 #include "SocketConnection.inl"
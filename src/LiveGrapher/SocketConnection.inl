@@ -2,13 +2,8 @@
 
 #pragma once
 
-#include <unistd.h>
-
 template <class T>
-void SocketConnection::queueWrite(T& buf) {
-    m_writequeue.emplace(reinterpret_cast<const char*>(&buf), sizeof(T));
-
-    // Select on write
-    selectflags |= SocketConnection::Write;
-    write(m_ipcfd_w, "r", 1);
+bool SocketConnection::queueWrite(T& buf, bool droppable) {
+    return queueWrite(reinterpret_cast<const char*>(&buf), sizeof(T),
+                      droppable);
 }
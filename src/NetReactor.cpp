@@ -0,0 +1,189 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#include "NetReactor.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <future>
+
+NetReactor& NetReactor::GetInstance() {
+    static NetReactor reactor;
+    return reactor;
+}
+
+NetReactor::~NetReactor() {
+    if (m_thread.joinable()) {
+        m_stop = true;
+
+        uint64_t one = 1;
+        write(m_eventfd, &one, sizeof(one));
+
+        m_thread.join();
+    }
+
+    if (m_eventfd != -1) {
+        close(m_eventfd);
+    }
+    if (m_epfd != -1) {
+        close(m_epfd);
+    }
+}
+
+bool NetReactor::Add(int fd, uint32_t events, Handler handler) {
+    if (fd == -1) {
+        return false;
+    }
+
+    bool added = false;
+    RunSync([&] {
+        // The handler would never be called
+        if (m_stopped) {
+            return;
+        }
+
+        auto entry = std::make_unique<Entry>();
+        entry->fd = fd;
+        entry->handler = std::move(handler);
+
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = entry.get();
+        if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            std::perror("NetReactor: epoll_ctl");
+            return;
+        }
+
+        m_entries[fd] = std::move(entry);
+        added = true;
+    });
+
+    return added;
+}
+
+void NetReactor::Remove(int fd) {
+    RunSync([&] {
+        auto entry = m_entries.find(fd);
+        if (entry == m_entries.end()) {
+            return;
+        }
+
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, nullptr);
+        entry->second->removed = true;
+        m_removed.emplace_back(std::move(entry->second));
+        m_entries.erase(entry);
+    });
+}
+
+void NetReactor::RunSync(std::function<void()> func) {
+    // Without a thread, there's nothing for the function to race with
+    if (InReactorThread() || !m_thread.joinable()) {
+        func();
+        return;
+    }
+
+    std::promise<void> done;
+    auto future = done.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        if (!m_stopped) {
+            m_calls.emplace_back([&] {
+                func();
+                done.set_value();
+            });
+        }
+    }
+
+    // The thread won't run the call, so waiting for it would never return
+    if (m_stopped) {
+        std::lock_guard<std::recursive_mutex> lock(m_stoppedMutex);
+        func();
+        return;
+    }
+
+    uint64_t one = 1;
+    write(m_eventfd, &one, sizeof(one));
+
+    future.wait();
+}
+
+bool NetReactor::InReactorThread() const {
+    return std::this_thread::get_id() == m_thread.get_id();
+}
+
+NetReactor::NetReactor() {
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epfd == -1 || m_eventfd == -1) {
+        std::perror("NetReactor");
+        return;
+    }
+
+    // A null data pointer marks the eventfd
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_eventfd, &event);
+
+    m_thread = std::thread([this] { threadmain(); });
+}
+
+void NetReactor::threadmain() {
+    epoll_event events[64];
+
+    while (!m_stop) {
+        int count = epoll_wait(m_epfd, events, 64, -1);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            std::perror("NetReactor: epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                // Reading resets the eventfd counter
+                uint64_t wakeups;
+                read(m_eventfd, &wakeups, sizeof(wakeups));
+                RunCalls();
+                continue;
+            }
+
+            auto entry = static_cast<Entry*>(events[i].data.ptr);
+            if (!entry->removed) {
+                entry->handler(events[i].events);
+            }
+        }
+
+        m_removed.clear();
+    }
+
+    /* Let callers blocked in RunSync() return. Later calls run on their
+     * callers' threads, after these finish.
+     */
+    std::lock_guard<std::recursive_mutex> stoppedLock(m_stoppedMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        m_stopped = true;
+    }
+    RunCalls();
+}
+
+void NetReactor::RunCalls() {
+    std::vector<std::function<void()>> calls;
+
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        calls.swap(m_calls);
+    }
+
+    for (auto& call : calls) {
+        call();
+    }
+}
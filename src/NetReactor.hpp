@@ -0,0 +1,96 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * One I/O thread shared by every robot network endpoint
+ *
+ * The reactor waits on all registered file descriptors with one epoll set and
+ * calls each descriptor's handler on its thread when the descriptor is ready.
+ * Components parse what they receive in their handlers and pass the results
+ * to the control thread through lock-free queues, so the control loop makes
+ * no network system calls to check for input.
+ *
+ * Handlers must not block. Add(), Remove() and RunSync() may be called from
+ * any thread, including from handlers.
+ */
+class NetReactor {
+public:
+    // Called with the ready epoll events, such as EPOLLIN
+    using Handler = std::function<void(uint32_t events)>;
+
+    static NetReactor& GetInstance();
+
+    ~NetReactor();
+    NetReactor(const NetReactor&) = delete;
+    NetReactor& operator=(const NetReactor&) = delete;
+
+    /* Calls 'handler' whenever 'fd' reports any of the epoll 'events'. Returns
+     * false if the descriptor couldn't be added.
+     */
+    bool Add(int fd, uint32_t events, Handler handler);
+
+    /* Stops calling the descriptor's handler. When called from another thread,
+     * this waits until the handler isn't running, so the state it uses may be
+     * destroyed afterward. Remove descriptors before closing them.
+     */
+    void Remove(int fd);
+
+    /* Runs 'func' on the reactor thread and waits for it to return. If the
+     * thread has exited, 'func' runs on the calling thread instead.
+     */
+    void RunSync(std::function<void()> func);
+
+    // Returns true if called from the reactor thread
+    bool InReactorThread() const;
+
+private:
+    struct Entry {
+        int fd;
+        Handler handler;
+        bool removed = false;
+    };
+
+    int m_epfd = -1;
+
+    // Wakes the thread to run functions queued by RunSync()
+    int m_eventfd = -1;
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+
+    // Set under m_callMutex when the thread exits, after which it runs no calls
+    std::atomic<bool> m_stopped{false};
+
+    // Serializes the functions RunSync() runs after the thread exited
+    std::recursive_mutex m_stoppedMutex;
+
+    // Registered descriptors, only accessed by the reactor thread
+    std::unordered_map<int, std::unique_ptr<Entry>> m_entries;
+
+    /* Entries removed while handling events. Their handlers may still be
+     * running or have events pending, so they're freed after the batch.
+     */
+    std::vector<std::unique_ptr<Entry>> m_removed;
+
+    // Functions queued by RunSync(); guarded by m_callMutex
+    std::vector<std::function<void()>> m_calls;
+    std::mutex m_callMutex;
+
+    NetReactor();
+
+    void threadmain();
+
+    // Runs functions queued by RunSync()
+    void RunCalls();
+};
@@ -15,10 +15,33 @@ Robot::Robot() {
     // dsDisplay.AddAutoMethod("Low bar", &Robot::AutoLowBar, this);
     // dsDisplay.AddAutoMethod("Portcullis", &Robot::AutoPortcullis, this);
 
+    // Used for testing purposes
+    dsDisplay.AddSubscriber(sf::IpAddress(10, 35, 12, 42), k_dsPort);
+
     // camera->StartAutomaticCapture();
 
     pidGraph.SetSendInterval(5ms);
 
+    // Sampled on the LiveGrapher sampler thread instead of in the robot loop
+    pidGraph.AddProbe("ShtHei SP", [this] {
+        return shooter.GetShooterHeightSetpoint().displacement;
+    });
+    pidGraph.AddProbe("Sht Height POS",
+                      [this] { return shooter.GetShooterHeight(); });
+    pidGraph.AddProbe("Sht Hght Spd", [this] {
+        return shooter.m_shooterHeightGrbx.GetSpeed();
+    });
+    // pidGraph.AddProbe("Left PV (DR)",
+    //                   [this] { return robotDrive.GetLeftDisplacement(); });
+    // pidGraph.AddProbe("Right PV (DR)",
+    //                   [this] { return robotDrive.GetRightDisplacement(); });
+    // pidGraph.AddProbe("Diff PID (DR)",
+    //                   [this] { return robotDrive.DiffPIDGet(); });
+    pidGraph.StartSampling(2ms);
+
+    // Lets the dashboard show whether the robot or the network is lagging
+    pidGraph.EnableTelemetry(100ms);
+
     displayTimer.Start();
 }
 
@@ -111,26 +134,12 @@ void Robot::Test() {
 }
 
 void Robot::DS_PrintOut() {
-    if (pidGraph.HasIntervalPassed()) {
-        pidGraph.GraphData(shooter.GetShooterHeightSetpoint().displacement,
-                           "ShtHei SP");
-        pidGraph.GraphData(shooter.GetShooterHeight(), "Sht Height POS");
-        pidGraph.GraphData(shooter.m_shooterHeightGrbx.GetSpeed(),
-                           "Sht Hght Spd");
-        // pidGraph.GraphData(robotDrive.GetLeftDisplacement(), "Left PV (DR)");
-        // pidGraph.GraphData(robotDrive.GetRightDisplacement(), "Right PV
-        // (DR)");
-        // pidGraph.GraphData(robotDrive.DiffPIDGet(), "Diff PID (DR)");
-
-        pidGraph.ResetInterval();
-    }
-
     if (displayTimer.HasPeriodPassed(0.5)) {
-        // Send things to DS display
+        // Send things to DS display. Only values that changed are sent.
         dsDisplay.Clear();
 
-        dsDisplay.AddData("ENCODER_LEFT", robotDrive.GetLeftDisplacement());
-        dsDisplay.AddData("ENCODER_RIGHT", robotDrive.GetRightDisplacement());
+        dsDisplay.AddData(encoderLeftID, robotDrive.GetLeftDisplacement());
+        dsDisplay.AddData(encoderRightID, robotDrive.GetRightDisplacement());
 
         dsDisplay.SendToDS();
     }
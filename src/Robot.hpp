@@ -52,7 +52,14 @@ private:
     // Used for sending data to the Driver Station
     DSDisplay& dsDisplay{DSDisplay::GetInstance(k_dsPort)};
 
-    // The LiveGrapher host
+    // IDs of the elements in GUISettings.txt that DS_PrintOut() updates
+    DSDisplay::ElementID encoderLeftID{dsDisplay.GetElementID("ENCODER_LEFT")};
+    DSDisplay::ElementID encoderRightID{
+        dsDisplay.GetElementID("ENCODER_RIGHT")};
+
+    /* The LiveGrapher host. It's declared after the subsystems its probes
+     * read so it's destroyed, and stops sampling, before they are.
+     */
     GraphHost pidGraph{3513};
 
     // Camera
@@ -72,6 +72,16 @@ public:
     ////////////////////////////////////////////////////////////
     unsigned short getLocalPort() const;
 
+    ////////////////////////////////////////////////////////////
+    /// \brief Get the socket's file descriptor
+    ///
+    /// This is used to wait for datagrams with NetReactor.
+    ///
+    /// \return File descriptor, or -1 if the socket isn't created
+    ///
+    ////////////////////////////////////////////////////////////
+    using Socket::getHandle;
+
     ////////////////////////////////////////////////////////////
     /// \brief Bind the socket to a specific port
     ///
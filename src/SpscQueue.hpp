@@ -0,0 +1,50 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+
+/**
+ * Fixed-capacity queue for passing items from one producer thread to one
+ * consumer thread without locks
+ *
+ * Push() and Pop() never block or allocate; Push() fails instead when the
+ * queue is full. Capacity must be a power of two.
+ */
+template <class T, size_t N>
+class SpscQueue {
+public:
+    static_assert(N > 0 && (N & (N - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+    // Producer: appends an item. Returns false if the queue is full.
+    bool Push(const T& item);
+
+    /* Producer: appends all 'count' items or none of them. The consumer sees
+     * either none or all of the items.
+     */
+    bool Push(const T* items, size_t count);
+
+    // Consumer: removes the oldest item. Returns false if the queue is empty.
+    bool Pop(T& item);
+
+    // Number of queued items (approximate if called during Push() or Pop())
+    size_t Size() const;
+
+    static constexpr size_t Capacity() { return N; }
+
+private:
+    // Index of the next slot to write, only modified by the producer
+    alignas(64) std::atomic<size_t> m_head{0};
+    size_t m_tailCache = 0;
+
+    // Index of the next slot to read, only modified by the consumer
+    alignas(64) std::atomic<size_t> m_tail{0};
+    size_t m_headCache = 0;
+
+    alignas(64) T m_items[N];
+};
+
+#include "SpscQueue.inl"
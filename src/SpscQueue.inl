@@ -0,0 +1,50 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+template <class T, size_t N>
+bool SpscQueue<T, N>::Push(const T& item) {
+    return Push(&item, 1);
+}
+
+template <class T, size_t N>
+bool SpscQueue<T, N>::Push(const T* items, size_t count) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+
+    // Only reload the consumer's index when the cached one says we're full
+    if (head + count - m_tailCache > N) {
+        m_tailCache = m_tail.load(std::memory_order_acquire);
+        if (head + count - m_tailCache > N) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        m_items[(head + i) & (N - 1)] = items[i];
+    }
+
+    m_head.store(head + count, std::memory_order_release);
+    return true;
+}
+
+template <class T, size_t N>
+bool SpscQueue<T, N>::Pop(T& item) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    if (tail == m_headCache) {
+        m_headCache = m_head.load(std::memory_order_acquire);
+        if (tail == m_headCache) {
+            return false;
+        }
+    }
+
+    item = m_items[tail & (N - 1)];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <class T, size_t N>
+size_t SpscQueue<T, N>::Size() const {
+    return m_head.load(std::memory_order_acquire) -
+           m_tail.load(std::memory_order_acquire);
+}
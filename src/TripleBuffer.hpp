@@ -0,0 +1,52 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * Passes the latest value from one producer thread to one consumer thread
+ * without locks
+ *
+ * The producer fills the write buffer and publishes it, which swaps it with the
+ * middle buffer. The consumer swaps the middle buffer into its read buffer
+ * when a new value has been published. Neither side ever waits for the other
+ * or allocates. Values the consumer didn't pick up before the next Publish()
+ * are overwritten.
+ */
+template <class T>
+class TripleBuffer {
+public:
+    // Producer: returns the buffer to fill before calling Publish()
+    T& WriteBuffer();
+
+    // Producer: makes the write buffer the latest value
+    void Publish();
+
+    /* Consumer: moves the latest value into the read buffer. Returns false if
+     * nothing was published since the last call.
+     */
+    bool Update();
+
+    // Consumer: returns the value picked up by the last Update()
+    const T& ReadBuffer() const;
+
+private:
+    // Set in m_middle when it holds a value the consumer hasn't picked up
+    static constexpr uint8_t k_newValue = 0x4;
+
+    T m_buffers[3];
+
+    // Index of the middle buffer, plus k_newValue
+    alignas(64) std::atomic<uint8_t> m_middle{1};
+
+    // Only used by the producer
+    alignas(64) uint8_t m_write = 0;
+
+    // Only used by the consumer
+    alignas(64) uint8_t m_read = 2;
+};
+
+#include "TripleBuffer.inl"
@@ -0,0 +1,32 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+template <class T>
+T& TripleBuffer<T>::WriteBuffer() {
+    return m_buffers[m_write];
+}
+
+template <class T>
+void TripleBuffer<T>::Publish() {
+    // Release makes the write buffer's contents visible with the new index
+    m_write = m_middle.exchange(m_write | k_newValue,
+                                std::memory_order_acq_rel) &
+              ~k_newValue;
+}
+
+template <class T>
+bool TripleBuffer<T>::Update() {
+    if ((m_middle.load(std::memory_order_relaxed) & k_newValue) == 0) {
+        return false;
+    }
+
+    // Swapping in the read buffer's index also clears k_newValue
+    m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & ~k_newValue;
+    return true;
+}
+
+template <class T>
+const T& TripleBuffer<T>::ReadBuffer() const {
+    return m_buffers[m_read];
+}
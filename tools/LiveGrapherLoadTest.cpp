@@ -0,0 +1,697 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+/* Measures how GraphHost performs with many clients and datasets.
+ *
+ * Usage: LiveGrapherLoadTest [-c clients] [-d datasets] [-r rate]
+ *                            [-i interval] [-t seconds] [-v version]
+ *                            [-p port] [-b rate] [-a age]
+ *
+ * -c clients   number of simulated clients (default 4)
+ * -d datasets  datasets each client subscribes to (default 16)
+ * -r rate      points per second published to each dataset (default 200)
+ * -i interval  send interval in milliseconds (default 5)
+ * -t seconds   length of the test (default 10)
+ * -v version   protocol version the clients use, 1 or 2 (default 2)
+ * -p port      port GraphHost listens on (default 3513)
+ * -b rate      with version 2, subscribe decimated at this many buckets per
+ *              second (default 0, every point)
+ * -a age       publish timestamps this many seconds in the past, the way
+ *              LiveGrapherReplay does (default 0)
+ *
+ * The main thread publishes synthetic datasets through GraphHost the same way
+ * the robot does. One thread runs all clients over epoll. Each point's value
+ * is the number of the tick it was published in, so clients can look up when
+ * it was published and compute the latency until it was received.
+ *
+ * Every second, the received throughput and the deepest client queue are
+ * printed. At the end, totals, CPU use and latency percentiles are printed.
+ * CPU time for GraphHost is the process total minus the client thread.
+ *
+ * With version 2, each client also sends k_hostTimeSyncPacket every 100 ms
+ * and feeds the replies to a ClockSync. The host and clients share a clock, so
+ * the reported offset should be near zero and the round trip time shows how
+ * long the socket thread takes to answer while under load.
+ *
+ * With -b, clients check that each dataset's points arrive as at most one
+ * bucket per period: the minimum, maximum and last point. A bucket closed too
+ * early would send more points for the same period.
+ */
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/ClockSync.hpp"
+#include "../common/Protocol.hpp"
+#include "../src/LiveGrapher/GraphHost.hpp"
+
+using namespace std::chrono_literals;
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+struct Options {
+    size_t clients = 4;
+    size_t datasets = 16;
+    double rate = 200.0;
+    int interval = 5;
+    double seconds = 10.0;
+    int version = 2;
+    int port = 3513;
+    int bucketRate = 0;
+    double age = 0.0;
+};
+
+// Reads a big-endian integer from 'buf'
+template <class T>
+static T Get(const char* buf) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value = (value << 8) | static_cast<uint8_t>(buf[i]);
+    }
+    return value;
+}
+
+static float GetFloat(const char* buf) {
+    uint32_t bits = Get<uint32_t>(buf);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Returns the system clock in microseconds since the epoch, like GraphHost
+static int64_t SystemMicroseconds() {
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Returns the CPU time used by the process or the calling thread
+static microseconds CpuTime(int who) {
+    rusage usage;
+    getrusage(who, &usage);
+
+    return microseconds{(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+                            1000000 +
+                        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec};
+}
+
+/**
+ * Simulated LiveGrapher clients. All of them are serviced by one thread so the
+ * clients cost as little CPU time as possible.
+ */
+class Clients {
+public:
+    Clients(const Options& options, const std::vector<std::atomic<int64_t>>&
+                                        publishTimes);
+    ~Clients();
+
+    // Connects and subscribes every client. Returns false on failure.
+    bool Connect();
+
+    void Start();
+    void Stop();
+
+    uint64_t ReceivedSamples() const;
+    uint64_t ReceivedBytes() const;
+
+    /* Most points received for one dataset in one bucket period; valid after
+     * Stop()
+     */
+    size_t MaxPointsPerPeriod() const;
+
+    // Publish-to-receive latencies in microseconds; valid after Stop()
+    std::vector<uint32_t>& Latencies();
+
+    /* CPU time used by the client thread so far. Only valid while it's
+     * running, so it can be read at the same moment as the process total.
+     */
+    microseconds CpuTime();
+
+    /* Returns the clock estimate of the client whose best exchange had the
+     * shortest round trip time; valid after Stop()
+     */
+    const ClockSync& BestClockSync() const;
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string buf;
+        ClockSync sync;
+
+        // Bucket period each dataset's last point fell in, and its points
+        std::vector<uint64_t> periods;
+        std::vector<size_t> periodPoints;
+    };
+
+    const Options& m_options;
+    const std::vector<std::atomic<int64_t>>& m_publishTimes;
+
+    std::vector<Client> m_clients;
+    int m_epfd = -1;
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+
+    std::atomic<uint64_t> m_receivedSamples{0};
+    std::atomic<uint64_t> m_receivedBytes{0};
+    std::vector<uint32_t> m_latencies;
+    size_t m_maxPointsPerPeriod = 0;
+
+    void Run();
+
+    // Asks the host for its clock
+    void SendTimeSync(Client& client);
+
+    // Reads everything available from a client
+    void Receive(Client& client);
+
+    // Consumes complete packets from the client's buffer
+    void Parse(Client& client);
+
+    // Records the latency of the point published in tick 'value'
+    void AddSample(float value, steady_clock::time_point now);
+
+    // Counts a decimated point toward its dataset's bucket period
+    void CountPeriod(Client& client, uint16_t dataset, uint64_t time);
+};
+
+Clients::Clients(const Options& options,
+                 const std::vector<std::atomic<int64_t>>& publishTimes)
+    : m_options(options), m_publishTimes(publishTimes) {}
+
+Clients::~Clients() {
+    Stop();
+
+    for (auto& client : m_clients) {
+        if (client.fd != -1) {
+            close(client.fd);
+        }
+    }
+    if (m_epfd != -1) {
+        close(m_epfd);
+    }
+}
+
+bool Clients::Connect() {
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epfd == -1) {
+        std::perror("epoll_create1");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    m_clients.resize(m_options.clients);
+    for (auto& client : m_clients) {
+        client.periods.resize(m_options.datasets, UINT64_MAX);
+        client.periodPoints.resize(m_options.datasets, 0);
+
+        client.fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (client.fd == -1 ||
+            connect(client.fd, reinterpret_cast<sockaddr*>(&addr),
+                    sizeof(addr)) == -1) {
+            std::perror("connect");
+            return false;
+        }
+
+        // Subscribe to every dataset in one write
+        std::string request;
+        if (m_options.version == 1) {
+            for (size_t i = 0; i < m_options.datasets; i++) {
+                request += static_cast<char>(k_hostConnectPacket | i);
+            }
+        } else {
+            HostHelloPacket hello{k_hostHelloPacket, 2};
+            request.append(reinterpret_cast<char*>(&hello), sizeof(hello));
+
+            for (size_t i = 0; i < m_options.datasets; i++) {
+                uint16_t dataset = htons(static_cast<uint16_t>(i));
+                if (m_options.bucketRate > 0) {
+                    HostSubscribeRatePacket subscribe{
+                        k_hostConnectRatePacket, dataset,
+                        htons(static_cast<uint16_t>(m_options.bucketRate))};
+                    request.append(reinterpret_cast<char*>(&subscribe),
+                                   sizeof(subscribe));
+                } else {
+                    HostSubscribePacket subscribe{k_hostConnectPacketV2,
+                                                  dataset};
+                    request.append(reinterpret_cast<char*>(&subscribe),
+                                   sizeof(subscribe));
+                }
+            }
+        }
+        if (send(client.fd, request.data(), request.size(), 0) !=
+            static_cast<ssize_t>(request.size())) {
+            std::perror("send");
+            return false;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        epoll_ctl(m_epfd, EPOLL_CTL_ADD, client.fd, &event);
+    }
+
+    return true;
+}
+
+void Clients::Start() {
+    m_thread = std::thread([this] { Run(); });
+}
+
+void Clients::Stop() {
+    if (m_thread.joinable()) {
+        m_stop = true;
+        m_thread.join();
+    }
+}
+
+uint64_t Clients::ReceivedSamples() const { return m_receivedSamples; }
+
+uint64_t Clients::ReceivedBytes() const { return m_receivedBytes; }
+
+size_t Clients::MaxPointsPerPeriod() const { return m_maxPointsPerPeriod; }
+
+std::vector<uint32_t>& Clients::Latencies() { return m_latencies; }
+
+microseconds Clients::CpuTime() {
+    clockid_t clock;
+    timespec time;
+    if (pthread_getcpuclockid(m_thread.native_handle(), &clock) != 0 ||
+        clock_gettime(clock, &time) == -1) {
+        return microseconds{0};
+    }
+
+    return duration_cast<microseconds>(std::chrono::seconds{time.tv_sec} +
+                                       nanoseconds{time.tv_nsec});
+}
+
+const ClockSync& Clients::BestClockSync() const {
+    const ClockSync* best = &m_clients[0].sync;
+    for (const auto& client : m_clients) {
+        if (client.sync.HasEstimate() &&
+            (!best->HasEstimate() ||
+             client.sync.RoundTripTime() < best->RoundTripTime())) {
+            best = &client.sync;
+        }
+    }
+    return *best;
+}
+
+void Clients::Run() {
+    epoll_event events[64];
+    auto nextSync = steady_clock::now();
+
+    while (!m_stop) {
+        if (m_options.version == 2 && steady_clock::now() >= nextSync) {
+            for (auto& client : m_clients) {
+                SendTimeSync(client);
+            }
+            nextSync += 100ms;
+        }
+
+        int count = epoll_wait(m_epfd, events, 64, 10);
+        for (int i = 0; i < count; i++) {
+            Receive(*static_cast<Client*>(events[i].data.ptr));
+        }
+    }
+}
+
+void Clients::SendTimeSync(Client& client) {
+    HostTimeSyncPacket request;
+    request.ID = k_hostTimeSyncPacket;
+    request.clientTime = htobe64(SystemMicroseconds());
+    send(client.fd, &request, sizeof(request), 0);
+}
+
+void Clients::Receive(Client& client) {
+    char buf[65536];
+
+    ssize_t count = recv(client.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (count <= 0) {
+        if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            epoll_ctl(m_epfd, EPOLL_CTL_DEL, client.fd, nullptr);
+        }
+        return;
+    }
+
+    m_receivedBytes.fetch_add(count, std::memory_order_relaxed);
+    client.buf.append(buf, count);
+    Parse(client);
+}
+
+void Clients::Parse(Client& client) {
+    auto now = steady_clock::now();
+
+    size_t pos = 0;
+    while (pos < client.buf.size()) {
+        const char* packet = &client.buf[pos];
+        size_t left = client.buf.size() - pos;
+        uint8_t id = packet[0];
+
+        if (m_options.version == 1 || (id & 0xC0) == k_clientDataPacket) {
+            if (left < sizeof(ClientDataPacket)) {
+                break;
+            }
+
+            AddSample(GetFloat(&packet[9]), now);
+            pos += sizeof(ClientDataPacket);
+        } else if (id == k_clientHelloPacket) {
+            if (left < sizeof(ClientHelloPacket)) {
+                break;
+            }
+            pos += sizeof(ClientHelloPacket);
+        } else if (id == k_clientTimeSyncPacket) {
+            if (left < sizeof(ClientTimeSyncPacket)) {
+                break;
+            }
+
+            client.sync.AddExchange(Get<uint64_t>(&packet[1]),
+                                    Get<uint64_t>(&packet[9]),
+                                    Get<uint64_t>(&packet[17]),
+                                    SystemMicroseconds());
+            pos += sizeof(ClientTimeSyncPacket);
+        } else if (id == k_clientFramePacket) {
+            if (left < sizeof(ClientFrameHeader)) {
+                break;
+            }
+
+            size_t length = Get<uint16_t>(&packet[1]);
+            if (left < sizeof(ClientFrameHeader) + length) {
+                break;
+            }
+
+            // Every dataset uses k_encodingFloat32
+            uint64_t baseTime = Get<uint64_t>(&packet[3]);
+            const char* sample = &packet[sizeof(ClientFrameHeader)];
+            const char* end = sample + length;
+            while (sample < end) {
+                uint16_t dataset = Get<uint16_t>(sample);
+                sample += 2;
+
+                uint64_t delta = 0;
+                int shift = 0;
+                do {
+                    delta |= static_cast<uint64_t>(*sample & 0x7f) << shift;
+                    shift += 7;
+                } while (*sample++ & 0x80);
+
+                if (m_options.bucketRate > 0) {
+                    CountPeriod(client, dataset, baseTime + delta);
+                }
+                AddSample(GetFloat(sample), now);
+                sample += 4;
+            }
+
+            pos += sizeof(ClientFrameHeader) + length;
+        } else {
+            std::fprintf(stderr, "unexpected packet 0x%02x\n", id);
+            pos = client.buf.size();
+        }
+    }
+
+    client.buf.erase(0, pos);
+}
+
+void Clients::AddSample(float value, steady_clock::time_point now) {
+    size_t tick = static_cast<size_t>(value);
+    if (tick < m_publishTimes.size()) {
+        nanoseconds published{
+            m_publishTimes[tick].load(std::memory_order_relaxed)};
+        m_latencies.emplace_back(
+            duration_cast<microseconds>(now.time_since_epoch() - published)
+                .count());
+    }
+
+    m_receivedSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Clients::CountPeriod(Client& client, uint16_t dataset, uint64_t time) {
+    if (dataset >= client.periods.size()) {
+        return;
+    }
+
+    // GraphHost aligns buckets to multiples of the period
+    uint64_t period = std::max(1000 / m_options.bucketRate, 1);
+    if (time / period != client.periods[dataset]) {
+        client.periods[dataset] = time / period;
+        client.periodPoints[dataset] = 0;
+    }
+
+    client.periodPoints[dataset]++;
+    m_maxPointsPerPeriod =
+        std::max(m_maxPointsPerPeriod, client.periodPoints[dataset]);
+}
+
+static void PrintUsage(const char* program) {
+    std::fprintf(stderr,
+                 "usage: %s [-c clients] [-d datasets] [-r rate] "
+                 "[-i interval] [-t seconds] [-v version] [-p port] "
+                 "[-b rate] [-a age]\n",
+                 program);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:d:r:i:t:v:p:b:a:")) != -1) {
+        switch (opt) {
+            case 'c':
+                options.clients = std::atoi(optarg);
+                break;
+            case 'd':
+                options.datasets = std::atoi(optarg);
+                break;
+            case 'r':
+                options.rate = std::atof(optarg);
+                break;
+            case 'i':
+                options.interval = std::atoi(optarg);
+                break;
+            case 't':
+                options.seconds = std::atof(optarg);
+                break;
+            case 'v':
+                options.version = std::atoi(optarg);
+                break;
+            case 'p':
+                options.port = std::atoi(optarg);
+                break;
+            case 'b':
+                options.bucketRate = std::atoi(optarg);
+                break;
+            case 'a':
+                options.age = std::atof(optarg);
+                break;
+            default:
+                PrintUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    size_t maxDatasets = options.version == 1 ? 64 : GraphHost::k_maxDatasets;
+    if (options.datasets == 0 || options.datasets > maxDatasets ||
+        options.rate <= 0.0 || options.seconds <= 0.0 ||
+        (options.version != 1 && options.version != 2) ||
+        options.bucketRate < 0 || options.bucketRate > UINT16_MAX ||
+        (options.version == 1 && options.bucketRate > 0) ||
+        options.age < 0.0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    size_t ticks = options.rate * options.seconds;
+    std::vector<std::atomic<int64_t>> publishTimes(ticks);
+
+    GraphHost host(options.port);
+    host.SetSendInterval(std::chrono::milliseconds(options.interval));
+
+    std::vector<GraphHost::DatasetHandle> datasets;
+    for (size_t i = 0; i < options.datasets; i++) {
+        datasets.emplace_back(host.RegisterDataset("Load" + std::to_string(i)));
+    }
+
+    for (int i = 0; i < 100 && !host.IsRunning(); i++) {
+        std::this_thread::sleep_for(10ms);
+    }
+    if (!host.IsRunning()) {
+        std::fprintf(stderr, "couldn't listen on port %d\n", options.port);
+        return 1;
+    }
+
+    Clients clients(options, publishTimes);
+    if (!clients.Connect()) {
+        return 1;
+    }
+    clients.Start();
+
+    // Wait for every client to be accepted and subscribed
+    while (host.GetClientStats().size() < options.clients) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(100ms);
+
+    std::printf("%zu clients, %zu datasets at %.0f Hz, %d ms interval, "
+                "protocol v%d\n",
+                options.clients, options.datasets, options.rate,
+                options.interval, options.version);
+
+    auto period = duration_cast<steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / options.rate));
+    auto start = steady_clock::now();
+    auto startCpu = CpuTime(RUSAGE_SELF);
+    auto clientsStartCpu = clients.CpuTime();
+    auto nextReport = start + 1s;
+    uint64_t lastSamples = 0;
+    size_t maxQueuedBytes = 0;
+
+    for (size_t tick = 0; tick < ticks; tick++) {
+        auto due = start + period * tick;
+        std::this_thread::sleep_until(due);
+
+        auto now = steady_clock::now();
+        publishTimes[tick].store(now.time_since_epoch().count(),
+                                 std::memory_order_relaxed);
+        if (options.age > 0.0) {
+            auto time = duration_cast<std::chrono::milliseconds>(
+                system_clock::now().time_since_epoch() -
+                std::chrono::duration<double>(options.age));
+            for (auto dataset : datasets) {
+                host.GraphData(tick, dataset, time.count());
+            }
+        } else {
+            for (auto dataset : datasets) {
+                host.GraphData(tick, dataset);
+            }
+        }
+        if (host.HasIntervalPassed()) {
+            host.ResetInterval();
+        }
+
+        if (now >= nextReport) {
+            size_t queuedBytes = 0;
+            uint64_t dropped = 0;
+            for (const auto& client : host.GetClientStats()) {
+                queuedBytes = std::max(queuedBytes, client.queuedBytes);
+                dropped += client.droppedPackets;
+            }
+            maxQueuedBytes = std::max(maxQueuedBytes, queuedBytes);
+
+            uint64_t samples = clients.ReceivedSamples();
+            std::printf("%5.1f s: %8llu points/s received, deepest queue %zu "
+                        "bytes, %llu packets dropped\n",
+                        std::chrono::duration<double>(now - start).count(),
+                        static_cast<unsigned long long>(samples - lastSamples),
+                        queuedBytes, static_cast<unsigned long long>(dropped));
+            lastSamples = samples;
+            nextReport += 1s;
+        }
+    }
+    host.Flush();
+
+    auto hostCpuEnd = CpuTime(RUSAGE_SELF);
+    auto clientsCpu = clients.CpuTime() - clientsStartCpu;
+    std::chrono::duration<double> elapsed = steady_clock::now() - start;
+
+    // Give the last points time to arrive
+    std::this_thread::sleep_for(200ms);
+    clients.Stop();
+
+    auto stats = host.GetStats();
+    uint64_t expected = ticks * options.datasets * options.clients;
+    uint64_t received = clients.ReceivedSamples();
+
+    std::printf("\nPublished %zu points, received %llu of %llu expected\n",
+                ticks * options.datasets,
+                static_cast<unsigned long long>(received),
+                static_cast<unsigned long long>(expected));
+    std::printf("Received %.0f points/s, %.1f KiB/s, %.2f bytes/point\n",
+                received / elapsed.count(),
+                clients.ReceivedBytes() / elapsed.count() / 1024,
+                received > 0
+                    ? static_cast<double>(clients.ReceivedBytes()) / received
+                    : 0.0);
+    std::printf("%llu flushes, %llu send calls, %llu points and %llu packets "
+                "dropped, deepest queue %zu bytes\n",
+                static_cast<unsigned long long>(stats.flushes),
+                static_cast<unsigned long long>(stats.sendCalls),
+                static_cast<unsigned long long>(stats.droppedSamples),
+                static_cast<unsigned long long>(stats.droppedPackets),
+                maxQueuedBytes);
+    std::printf("Longest GraphData() call %lld ns\n",
+                static_cast<long long>(stats.maxPublishTime.count()));
+
+    bool bucketsOk = clients.MaxPointsPerPeriod() <= 3;
+    if (options.bucketRate > 0) {
+        std::printf("Decimation: at most %zu points per bucket period%s\n",
+                    clients.MaxPointsPerPeriod(),
+                    bucketsOk ? "" : ", expected at most 3");
+    }
+
+    auto totalCpu = hostCpuEnd - startCpu;
+    auto hostCpu = totalCpu - clientsCpu;
+    std::printf("CPU: %.1f%% GraphHost and publisher, %.1f%% clients\n",
+                100.0 * hostCpu.count() / 1e6 / elapsed.count(),
+                100.0 * clientsCpu.count() / 1e6 / elapsed.count());
+
+    const auto& sync = clients.BestClockSync();
+    if (sync.HasEstimate()) {
+        std::printf("Clock: offset %lld us, round trip time %lld us\n",
+                    static_cast<long long>(sync.Offset()),
+                    static_cast<long long>(sync.RoundTripTime()));
+    }
+
+    auto& latencies = clients.Latencies();
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min<size_t>(latencies.size() * p,
+                                              latencies.size() - 1)];
+        };
+        std::printf("Latency (us): p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+                    percentile(0.5), percentile(0.9), percentile(0.99),
+                    percentile(0.999), latencies.back());
+
+        // Power-of-two histogram
+        std::printf("Latency histogram:\n");
+        size_t bucket = 0;
+        for (uint32_t limit = 1; bucket < latencies.size(); limit *= 2) {
+            auto end = std::upper_bound(latencies.begin() + bucket,
+                                        latencies.end(), limit - 1);
+            size_t count = end - latencies.begin() - bucket;
+            if (count > 0) {
+                std::printf("  < %7u us: %9zu (%5.2f%%)\n", limit, count,
+                            100.0 * count / latencies.size());
+            }
+            bucket += count;
+        }
+    }
+
+    return bucketsOk ? 0 : 1;
+}
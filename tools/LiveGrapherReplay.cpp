@@ -0,0 +1,339 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+/* Serves recordings made by GraphHost::StartRecording() to LiveGrapher clients
+ * over the normal LiveGrapher protocol, so matches can be reviewed without a
+ * robot.
+ *
+ * Usage: LiveGrapherReplay [-p port] [-s speed] [-l] file...
+ *
+ * -p port   port to listen on (default 3513)
+ * -s speed  playback speed as a multiple of real time, or "max" to send as
+ *           fast as clients can take it (default 1)
+ * -l        repeat the recordings until interrupted
+ *
+ * Files are played in the order given. Playback starts once the first client
+ * connects. Gaps of more than a second between points, such as between robot
+ * restarts, are skipped.
+ */
+
+#include <getopt.h>
+#include <signal.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/LiveGrapher/GraphHost.hpp"
+
+using namespace std::chrono_literals;
+
+static std::atomic<bool> g_stop{false};
+
+static void HandleSignal(int) { g_stop = true; }
+
+// Reads a big-endian integer from 'buf'
+template <class T>
+static T Get(const char* buf) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value = (value << 8) | static_cast<uint8_t>(buf[i]);
+    }
+    return value;
+}
+
+class Replay {
+public:
+    // A speed of zero plays as fast as possible
+    Replay(GraphHost& host, double speed);
+
+    /* Reads a recording and registers its datasets with the host. Returns
+     * false if the file can't be read or isn't a recording.
+     */
+    bool Load(const std::string& path);
+
+    // Plays every loaded recording once
+    void Play();
+
+    // Returns the number of points sent
+    uint64_t Samples() const;
+
+private:
+    GraphHost& m_host;
+    double m_speed;
+
+    std::vector<std::string> m_recordings;
+
+    // Host dataset handles indexed by the recording's dataset IDs
+    std::vector<GraphHost::DatasetHandle> m_handles;
+
+    // Recording and wall clock times that playback is measured from
+    uint64_t m_startTime = 0;
+    uint64_t m_lastTime = 0;
+    std::chrono::steady_clock::time_point m_wallStart;
+
+    uint64_t m_samples = 0;
+
+    /* Calls 'datasetFunc' for each dataset record and 'sampleFunc' for each
+     * sample record in a recording. Returns false if the recording is
+     * truncated or malformed.
+     */
+    template <class DatasetFunc, class SampleFunc>
+    static bool Parse(const std::string& data, DatasetFunc datasetFunc,
+                      SampleFunc sampleFunc);
+
+    // Waits until a point at 'time' is due to be sent
+    void WaitFor(uint64_t time);
+
+    // Sends a point, waiting for the socket thread if its queue is full
+    void Publish(GraphHost::DatasetHandle dataset, uint64_t time, float value);
+};
+
+Replay::Replay(GraphHost& host, double speed) : m_host(host), m_speed(speed) {}
+
+bool Replay::Load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    std::string data{std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>()};
+
+    if (data.size() < GraphRecorder::k_headerSize ||
+        data.compare(0, 4, "LGR1") != 0) {
+        std::fprintf(stderr, "%s: not a LiveGrapher recording\n",
+                     path.c_str());
+        return false;
+    }
+
+    // Register every dataset before clients ask for the list
+    bool valid = Parse(
+        data,
+        [&](uint16_t, const std::string& name) {
+            m_host.RegisterDataset(name);
+        },
+        [](uint16_t, uint64_t, float) {});
+    if (!valid) {
+        std::fprintf(stderr, "%s: truncated, playing the valid part\n",
+                     path.c_str());
+    }
+
+    m_recordings.emplace_back(std::move(data));
+    return true;
+}
+
+void Replay::Play() {
+    m_startTime = 0;
+    m_lastTime = 0;
+
+    for (const auto& data : m_recordings) {
+        // Dataset IDs are only valid within one recording
+        m_handles.assign(GraphHost::k_maxDatasets,
+                         GraphHost::k_invalidDataset);
+
+        Parse(data,
+              [&](uint16_t dataset, const std::string& name) {
+                  if (dataset < m_handles.size()) {
+                      m_handles[dataset] = m_host.RegisterDataset(name);
+                  }
+              },
+              [&](uint16_t dataset, uint64_t time, float value) {
+                  if (g_stop || dataset >= m_handles.size()) {
+                      return;
+                  }
+
+                  WaitFor(time);
+                  Publish(m_handles[dataset], time, value);
+              });
+
+        if (g_stop) {
+            break;
+        }
+    }
+
+    m_host.Flush();
+}
+
+uint64_t Replay::Samples() const { return m_samples; }
+
+template <class DatasetFunc, class SampleFunc>
+bool Replay::Parse(const std::string& data, DatasetFunc datasetFunc,
+                   SampleFunc sampleFunc) {
+    size_t pos = GraphRecorder::k_headerSize;
+
+    while (pos < data.size()) {
+        const char* record = &data[pos];
+        size_t left = data.size() - pos;
+
+        if (record[0] == GraphRecorder::k_recordEnd) {
+            return true;
+        } else if (record[0] == GraphRecorder::k_recordDataset) {
+            if (left < 4 || left < 4u + static_cast<uint8_t>(record[3])) {
+                return false;
+            }
+
+            size_t length = static_cast<uint8_t>(record[3]);
+            datasetFunc(Get<uint16_t>(&record[1]),
+                        std::string(&record[4], length));
+            pos += 4 + length;
+        } else if (record[0] == GraphRecorder::k_recordSample) {
+            if (left < GraphRecorder::k_sampleRecordSize) {
+                return false;
+            }
+
+            uint32_t bits = Get<uint32_t>(&record[11]);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+
+            sampleFunc(Get<uint16_t>(&record[1]), Get<uint64_t>(&record[3]),
+                       value);
+            pos += GraphRecorder::k_sampleRecordSize;
+        } else {
+            return false;
+        }
+    }
+
+    // A recording that was cut off has no end marker
+    return false;
+}
+
+void Replay::WaitFor(uint64_t time) {
+    using std::chrono::duration;
+    using std::chrono::duration_cast;
+    using std::chrono::steady_clock;
+
+    if (m_speed == 0.0) {
+        return;
+    }
+
+    // Start over at the first point and after gaps or jumps back in time
+    if (m_startTime == 0 || time < m_lastTime || time - m_lastTime > 1000) {
+        m_startTime = time;
+        m_wallStart = steady_clock::now();
+    }
+    m_lastTime = time;
+
+    duration<double, std::milli> offset{(time - m_startTime) / m_speed};
+    auto due = m_wallStart + duration_cast<steady_clock::duration>(offset);
+    if (due > steady_clock::now()) {
+        // Send everything that was due before sleeping
+        m_host.Flush();
+        std::this_thread::sleep_until(due);
+    }
+}
+
+void Replay::Publish(GraphHost::DatasetHandle dataset, uint64_t time,
+                     float value) {
+    if (dataset == GraphHost::k_invalidDataset) {
+        return;
+    }
+
+    // If the socket thread falls behind, give it a chance to catch up
+    while (!m_host.GraphData(value, dataset, time)) {
+        if (g_stop || !m_host.IsRunning()) {
+            return;
+        }
+
+        m_host.Flush();
+        std::this_thread::sleep_for(1ms);
+    }
+
+    m_samples++;
+
+    // At full speed there are no pauses to flush in
+    if (m_speed == 0.0 && m_samples % 256 == 0) {
+        m_host.Flush();
+    }
+}
+
+static void PrintUsage(const char* program) {
+    std::fprintf(stderr, "usage: %s [-p port] [-s speed|max] [-l] file...\n",
+                 program);
+}
+
+int main(int argc, char* argv[]) {
+    int port = 3513;
+    double speed = 1.0;
+    bool loop = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:l")) != -1) {
+        if (opt == 'p') {
+            port = std::atoi(optarg);
+        } else if (opt == 's') {
+            speed = std::strcmp(optarg, "max") == 0 ? 0.0 : std::atof(optarg);
+            if (speed <= 0.0 && std::strcmp(optarg, "max") != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (opt == 'l') {
+            loop = true;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind == argc) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    GraphHost host(port);
+    Replay replay(host, speed);
+
+    for (int i = optind; i < argc; i++) {
+        if (!replay.Load(argv[i])) {
+            return 1;
+        }
+    }
+
+    // Give the socket thread time to start listening
+    for (int i = 0; i < 100 && !host.IsRunning(); i++) {
+        std::this_thread::sleep_for(10ms);
+    }
+    if (!host.IsRunning()) {
+        std::fprintf(stderr, "couldn't listen on port %d\n", port);
+        return 1;
+    }
+
+    std::printf("Waiting for a client on port %d\n", port);
+    while (!g_stop && host.GetClientStats().empty()) {
+        std::this_thread::sleep_for(50ms);
+    }
+
+    // Let the client request the dataset list and subscribe
+    std::this_thread::sleep_for(500ms);
+
+    auto start = std::chrono::steady_clock::now();
+    do {
+        replay.Play();
+    } while (loop && !g_stop);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    // Let the socket thread send what's left
+    std::this_thread::sleep_for(100ms);
+
+    auto stats = host.GetStats();
+    std::printf("Sent %llu points in %.2f s (%.0f points/s), %llu bytes\n",
+                static_cast<unsigned long long>(replay.Samples()),
+                elapsed.count(), replay.Samples() / elapsed.count(),
+                static_cast<unsigned long long>(stats.sentBytes));
+    std::printf("Dropped %llu packets from full client queues\n",
+                static_cast<unsigned long long>(stats.droppedPackets));
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2016-2017 FRC Team 3512. All Rights Reserved.
+
+/* Prints the points GraphHost publishes into a shared memory ring, as a
+ * template for loggers and watchdogs that run next to the robot program.
+ *
+ * Usage: LiveGrapherRingDump [-n name] [-q]
+ *
+ * -n name  shared memory object to read (default "/livegrapher")
+ * -q       only print the number of points read and lost each second
+ *
+ * Waits for the ring to appear, and reopens it when the robot program
+ * restarts.
+ */
+
+#include <getopt.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "../common/GraphRingReader.hpp"
+
+using namespace std::chrono_literals;
+
+static std::atomic<bool> g_stop{false};
+
+static void HandleSignal(int) { g_stop = true; }
+
+int main(int argc, char* argv[]) {
+    std::string name = "/livegrapher";
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:q")) != -1) {
+        if (opt == 'n') {
+            name = optarg;
+        } else if (opt == 'q') {
+            quiet = true;
+        } else {
+            std::fprintf(stderr, "usage: %s [-n name] [-q]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    GraphRingReader reader;
+    GraphRingReader::Sample sample;
+
+    uint64_t samples = 0;
+    auto nextReport = std::chrono::steady_clock::now() + 1s;
+
+    while (!g_stop) {
+        if (!reader.IsOpen() || reader.IsWriterClosed()) {
+            if (!reader.Open(name)) {
+                std::this_thread::sleep_for(100ms);
+                continue;
+            }
+            std::fprintf(stderr, "Reading %s\n", name.c_str());
+        }
+
+        while (reader.Read(sample)) {
+            samples++;
+            if (!quiet) {
+                std::printf("%" PRIu64 " %s %g\n", sample.time,
+                            reader.DatasetName(sample.dataset).c_str(),
+                            sample.value);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (quiet && now >= nextReport) {
+            std::printf("%" PRIu64 " points, %" PRIu64 " lost\n", samples,
+                        reader.LostSamples());
+            samples = 0;
+            nextReport = now + 1s;
+        }
+
+        // Polling costs no system calls other than this sleep
+        std::this_thread::sleep_for(1ms);
+    }
+
+    return 0;
+}